@@ -3,8 +3,72 @@
     #include <string>         // For string operations
     #include <sqlite3.h>      // For SQLite database functionality
     #include <iomanip>        // For output formatting (like setw)
+    #include <memory>         // For owning connection handles
+    #include <mutex>          // For guarding the connection pool
+    #include <condition_variable> // For waiting on a free pooled connection
+    #include <list>           // For the statement cache's recency order
+    #include <unordered_map>  // For looking up cached statements by SQL text
+    #include <atomic>         // For statement cache counters read across threads
+    #include <cstdint>        // For fixed-width counters
+    #include <thread>         // For the group-commit writer thread
+    #include <future>         // For handing each queued booking its own result
+    #include <deque>          // For the queue of pending bookings
+    #include <chrono>         // For the group-commit time window
+    #include <shared_mutex>   // For concurrent readers of the seat index
+    #include <algorithm>      // For sorting and searching seat lists
+    #include <cstring>        // For comparing table names in the update hook
+    #include <fstream>        // For reading batch command files
+    #include <string_view>    // For CSV fields that point into the mapped file
+    #include <charconv>       // For parsing numbers out of CSV fields
+    #include <functional>     // For the importers' per-row callbacks
+    #include <tuple>          // For the member list of a row mapper
+    #include <array>          // For a row mapper's column positions
+    #include <map>            // For the ordered route map
+    #include <set>            // For the flights on one route
+    #include <random>         // For the benchmark's synthetic data and call order
+    #include <sstream>        // For feeding the display functions during benchmarks
+    #include <cmath>          // For benchmark percentile ranks
+    #include <sys/mman.h>     // For memory-mapping import files
+    #include <sys/stat.h>     // For the size of an import file
+    #include <fcntl.h>        // For opening import files
+    #include <unistd.h>       // For closing import files
+    #if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #include <immintrin.h>    // For the AVX2 seat bitmap scan
+    #define SEAT_SCAN_AVX2 1  // Build the AVX2 scan; it is only used if the CPU supports it
+    #endif
     using namespace std;
     const string DB_FILE = "database.db"; // Defines the SQLite database filename
+    const size_t MAX_CONNECTIONS = 8;     // Upper bound on simultaneously open connections
+    const size_t MAX_SCRATCH_CONNECTIONS = 64;  // Largest pool --loadgen may open, one connection per thread
+    const size_t SERVICE_CONNECTIONS = 3;       // Main, group-commit writer and checkpointer, besides the agents
+    const int BUSY_TIMEOUT_MS = 5000;     // How long a connection waits on a locked database
+    const size_t STATEMENT_CACHE_SIZE = 64; // Compiled statements kept per connection
+    const size_t GROUP_COMMIT_MAX_OPS = 64;  // Bookings committed together at most
+    const int GROUP_COMMIT_WINDOW_US = 2000; // How long the first queued booking waits for company
+    const int CATALOG_CHECK_INTERVAL_MS = 100;  // How often the flight catalog looks for other processes' writes
+    const int CATALOG_MAX_STALENESS_MS = 1000;  // Longest the catalog trusts itself while commits interleave
+    const int BATCH_TRANSACTION_SIZE = 1000;    // Batch commands committed together
+    const int IMPORT_CHUNK_ROWS = 50000;        // CSV rows committed together by the importer
+    const size_t EXPORT_BUFFER_BYTES = 1 << 20; // Output buffered before each write by exports
+    const size_t LIST_PAGE_SIZE = 20;           // Rows shown per screen by the listing menus
+    const int CONNECTION_MAX_LEGS = 3;          // Default leg limit for connection searches
+    const size_t CONNECTION_MAX_RESULTS = 20;   // Itineraries returned by a connection search
+    const sqlite3_int64 MIGRATION_BATCH_ROWS = 20000;  // Source rowids copied per transaction by a table rebuild
+    const size_t TRACE_RING_EVENTS = 1 << 14;   // Newest spans kept per thread by --trace
+    const size_t PROFILE_KNOWN_STATEMENTS = 256;  // Statement addresses remembered per thread by --profile
+
+    // Storage settings applied to every pooled connection
+    // This is the only place journal, cache and checkpoint behaviour is configured
+    struct StorageConfig {
+        const char* journalMode = "WAL";       // Readers never block the booking writer
+        const char* synchronous = "FULL";      // Every commit is durable once it returns
+        int cacheSizeKiB = 16384;              // Page cache per connection
+        long long mmapSizeBytes = 268435456;   // Memory-map up to 256 MiB of the database file
+        int checkpointIntervalMs = 500;        // How often the checkpoint manager wakes up
+        int passiveCheckpointFrames = 1000;    // WAL frames that trigger a passive checkpoint
+        int quietPeriodMs = 5000;              // Time without commits before truncating the WAL
+    };
+    StorageConfig storageConfig;               // Settings in effect for this process
     // Forward declarations
     struct User;              // Forward declaration of User struct
     struct Flight;            // Forward declaration of Flight struct
@@ -16,10 +80,14 @@
         int seatNumber;       // Seat assignment
 
         void display() const {  // Method to display user information
-            cout << left << setw(15) << "Name:" << name << endl;
-            cout << setw(15) << "User ID:" << userID << endl;
-            cout << setw(15) << "Flight Number:" << flightNumber << endl;
-            cout << setw(15) << "Seat Number:" << seatNumber << endl;
+            cout << left << setw(15) << "Name:" << name << "\n";
+            cout << setw(15) << "User ID:" << userID << "\n";
+            if (flightNumber.empty()) {  // A passenger whose bookings were all cancelled
+                cout << setw(15) << "Bookings:" << "(no reservations)\n";
+                return;
+            }
+            cout << setw(15) << "Flight Number:" << flightNumber << "\n";
+            cout << setw(15) << "Seat Number:" << seatNumber << "\n";
         }
     };
     struct Flight {
@@ -31,20 +99,915 @@
         int availableTickets;    // Seats remaining
 
         void display() const {   // Method to display flight information
-            cout << left << setw(20) << "Flight Number:" << flightNumber << endl;
-            cout << setw(20) << "Airline Name:" << airlineName << endl;
-            cout << setw(20) << "Starting Point:" << startingPoint << endl;
-            cout << setw(20) << "Destination:" << destination << endl;
-            cout << setw(20) << "Total Tickets:" << totalTickets << endl;
-            cout << setw(20) << "Available Tickets:" << availableTickets << endl;
+            cout << left << setw(20) << "Flight Number:" << flightNumber << "\n";
+            cout << setw(20) << "Airline Name:" << airlineName << "\n";
+            cout << setw(20) << "Starting Point:" << startingPoint << "\n";
+            cout << setw(20) << "Destination:" << destination << "\n";
+            cout << setw(20) << "Total Tickets:" << totalTickets << "\n";
+            cout << setw(20) << "Available Tickets:" << availableTickets << "\n";
+        }
+    };
+
+    // Row mapping - Typed reads of query results into User and Flight
+
+    // One struct member and the result column it is read from
+    template <typename Row, typename T>
+    struct Column {
+        const char* name;  // Result column name
+        T Row::*member;    // Member that receives the value
+    };
+
+    // Pairs a column name with a member pointer
+    // @param name: Result column name
+    // @param member: Member that receives the value
+    template <typename Row, typename T>
+    constexpr Column<Row, T> column(const char* name, T Row::*member) {
+        return Column<Row, T>{name, member};
+    }
+
+    // Typed column reads; NULL reads as an empty string or zero
+    inline void readColumn(sqlite3_stmt* stmt, int index, string& value) {
+        const unsigned char* text = sqlite3_column_text(stmt, index);
+        value.assign(text ? reinterpret_cast<const char*>(text) : "", sqlite3_column_bytes(stmt, index));
+    }
+    inline void readColumn(sqlite3_stmt* stmt, int index, int& value) {
+        value = sqlite3_column_int(stmt, index);
+    }
+
+    // Reads result rows into a struct through a fixed list of member pointers.
+    // Column positions are looked up by name once per statement (bind); each row is
+    // then read with the sqlite3_column_* call matching the member's type.
+    template <typename Row, typename... Ts>
+    class RowMapper {
+    public:
+        // A mapper's column positions in one prepared statement
+        class Bound {
+        public:
+            // Copies the current row of the statement into row
+            // Members whose column isn't in the result are left untouched
+            void read(sqlite3_stmt* stmt, Row& row) const { readAll(stmt, row, index_sequence_for<Ts...>()); }
+
+        private:
+            friend class RowMapper;
+            explicit Bound(const RowMapper& mapper) : mapper(mapper) {}
+
+            template <size_t... I>
+            void readAll(sqlite3_stmt* stmt, Row& row, index_sequence<I...>) const {
+                ((positions[I] >= 0 ? readColumn(stmt, positions[I], row.*(get<I>(mapper.columns).member))
+                                    : void()), ...);
+            }
+
+            const RowMapper& mapper;               // Member pointers
+            array<int, sizeof...(Ts)> positions;   // Result column of each member, or -1
+        };
+
+        constexpr RowMapper(Column<Row, Ts>... columns) : columns(columns...) {}
+
+        // @return: The mapped column names, comma separated, for a SELECT list
+        string selectList() const {
+            string list;
+            apply([&](const auto&... mapped) { ((list += (list.empty() ? "" : ", "), list += mapped.name), ...); },
+                  columns);
+            return list;
+        }
+
+        // Finds each mapped column in a prepared statement's result
+        // @param stmt: Prepared statement whose rows will be read
+        // @return: Reader for the statement's rows
+        Bound bind(sqlite3_stmt* stmt) const {
+            Bound bound(*this);
+            int count = sqlite3_column_count(stmt);
+            size_t i = 0;
+            apply([&](const auto&... mapped) {
+                ((bound.positions[i++] = find(stmt, count, mapped.name)), ...);
+            }, columns);
+            return bound;
+        }
+
+        // Steps a statement to completion, reading each row and passing it to fn
+        // @param stmt: Prepared statement with its parameters bound
+        // @param fn: Called with each row
+        // @return: false if stepping the statement failed
+        template <typename Fn>
+        bool forEach(sqlite3_stmt* stmt, Fn&& fn) const {
+            Bound bound = bind(stmt);
+            int rc;
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                Row row{};
+                bound.read(stmt, row);
+                fn(row);
+            }
+            return rc == SQLITE_DONE;
+        }
+
+    private:
+        static int find(sqlite3_stmt* stmt, int count, const char* name) {
+            for (int i = 0; i < count; i++) {
+                if (strcmp(sqlite3_column_name(stmt, i), name) == 0) return i;
+            }
+            return -1;
+        }
+
+        tuple<Column<Row, Ts>...> columns;  // Mapped members in SELECT order
+    };
+
+    // Column mappings for the two tables
+    const RowMapper FLIGHT_ROW(column("flightNumber", &Flight::flightNumber),
+                               column("airlineName", &Flight::airlineName),
+                               column("startingPoint", &Flight::startingPoint),
+                               column("destination", &Flight::destination),
+                               column("totalTickets", &Flight::totalTickets),
+                               column("availableTickets", &Flight::availableTickets));
+    const RowMapper USER_ROW(column("userID", &User::userID),
+                             column("name", &User::name),
+                             column("flightNumber", &User::flightNumber),
+                             column("seatNumber", &User::seatNumber));
+
+    // One page of a keyset-paginated listing
+    template <typename Row>
+    struct Page {
+        vector<Row> rows;   // Rows in key order
+        string nextAfter;   // Key of the last row; pass it as "after" for the next page
+        bool more = false;  // Rows exist beyond this page
+    };
+
+    // Totals of statement cache activity, summed over connections
+    struct StatementCacheStats {
+        uint64_t hits = 0;       // Lookups served by an already compiled statement
+        uint64_t misses = 0;     // Lookups that had to call sqlite3_prepare_v2
+        uint64_t evictions = 0;  // Statements finalized to stay within capacity
+    };
+
+    // Compiled statements of one connection, keyed by their SQL text.
+    // A statement is prepared on its first use and reused afterwards; when more than
+    // `capacity` statements are cached the least recently used idle one is finalized.
+    class StatementCache {
+    public:
+        explicit StatementCache(size_t capacity = STATEMENT_CACHE_SIZE) : capacity(capacity) {}
+        ~StatementCache() { clear(); }
+
+        // Returns a compiled statement for sql, ready to bind and step
+        // @param db: Connection owning this cache
+        // @param sql: Query text, also used as the cache key
+        // @param cached: Set to false if the statement is a one-off that the caller must finalize
+        // @return: The statement, or nullptr if it fails to compile
+        sqlite3_stmt* acquire(sqlite3* db, const string& sql, bool& cached);
+
+        // Hands a statement back after use, resetting it and clearing its bindings
+        // @param stmt: Statement returned by acquire() with cached == true
+        void release(sqlite3_stmt* stmt);
+
+        // Finalizes every cached statement
+        void clear();
+
+        // Adds this cache's counters to totals
+        void addStats(StatementCacheStats& totals) const;
+
+    private:
+        struct Entry {
+            string sql;                  // Cache key
+            sqlite3_stmt* stmt;          // Compiled statement
+            bool inUse;                  // Borrowed by a StatementHandle right now
+        };
+
+        void evict();                    // Finalizes idle entries beyond capacity
+
+        size_t capacity;                                     // Maximum number of cached statements
+        list<Entry> entries;                                 // Most recently used first
+        unordered_map<string, list<Entry>::iterator> index; // SQL text -> entry
+        unordered_map<sqlite3_stmt*, list<Entry>::iterator> byStmt; // Statement -> entry
+        atomic<uint64_t> hits{0}, misses{0}, evictions{0};  // Read by other threads for stats
+    };
+
+    // A long-lived SQLite connection handed out by the ConnectionPool
+    struct Connection {
+        sqlite3* db = nullptr;   // Open database handle, closed only when the pool is destroyed
+        StatementCache statements;  // Statements compiled on this connection
+        vector<sqlite3_int64> changedFlights;  // Flights rowids written by the open transaction
+        long long dataVersion = -1;            // Last PRAGMA data_version seen on this connection
+        uint64_t seenLocalCommits = 0;         // Process commit count when dataVersion was read
+    };
+
+    // Owns every open database connection in the process.
+    // Each thread is bound to one connection the first time it needs the database and
+    // keeps it until the thread exits, so repeated calls reuse the same handle instead
+    // of reopening database.db and re-parsing the schema. At most maxConnections handles
+    // are open at once, so at most maxConnections threads can use the database: a further
+    // thread blocks in acquire() until a bound thread exits. Size the pool for every thread
+    // that touches the database for the whole run.
+    class ConnectionPool {
+    public:
+        // Returns the process-wide pool
+        static ConnectionPool& instance();
+
+        // Changes the database file and pool size; only valid before the first acquire()
+        // @param path: Database file to open
+        // @param maxConnections: Maximum number of simultaneously open connections
+        void configure(const string& path, size_t maxConnections);
+
+        // Returns the calling thread's connection, opening or waiting for one if needed.
+        // The connection stays bound until the thread exits.
+        // @return: The thread's connection, or nullptr if the database can't be opened
+        Connection* acquire();
+
+        // Returns a connection to the idle list so a waiting thread can take it
+        // @param conn: Connection previously returned by acquire()
+        void release(Connection* conn);
+
+        // Sums statement cache counters over every open connection
+        StatementCacheStats statementStats();
+
+        ~ConnectionPool();
+
+    private:
+        ConnectionPool() = default;
+        Connection* open();      // Opens a new connection (called with the mutex held)
+
+        mutex mtx;                            // Guards every member below
+        condition_variable connectionFreed;   // Signalled when a connection becomes idle
+        vector<unique_ptr<Connection>> connections;  // Every connection opened so far
+        vector<Connection*> idle;             // Connections not bound to any thread
+        string path = DB_FILE;                // Database file to open
+        size_t maxConnections = MAX_CONNECTIONS;  // Pool bound
+    };
+
+    // Tracing - Spans of each request and the SQL work under it, in Chrome's trace-event format
+
+    // One finished (or still open) span in a thread's ring
+    struct TraceEvent {
+        char name[32];             // Span name, truncated
+        char detail[72];           // Statement text, file name or command line, truncated
+        uint64_t sequence;         // Spans the thread had started before this one; tells a reused slot apart
+        uint64_t startNanos;       // Since tracing was enabled
+        uint64_t durationNanos;    // TRACE_OPEN until the span ends
+    };
+
+    const uint64_t TRACE_OPEN = UINT64_MAX;  // durationNanos of a span that hasn't ended
+
+    // One thread's spans. Only the owning thread writes, between TraceRecorder::beginChange and
+    // endChange; the ring is read when the trace is written, once no change is in progress.
+    struct ThreadTrace {
+        vector<TraceEvent> ring = vector<TraceEvent>(TRACE_RING_EVENTS);  // Span n is kept in slot n % TRACE_RING_EVENTS
+        uint64_t started = 0;  // Spans started so far
+        atomic<bool> changing{false};  // Set while the owner writes to ring or started
+        int thread = 0;        // Small id shown as the trace's tid
+        string name;           // Shown as the thread's name; guarded by the recorder's lock
+    };
+
+    // Records nested spans on every thread into per-thread rings and writes them as a
+    // Chrome trace-event file (chrome://tracing, Perfetto) when the process exits. A span
+    // costs a clock read and a copy into the ring, with no lock. Besides the spans opened
+    // by the code, a VFS shim records each fsync and a busy handler records each wait on
+    // another connection's lock. Off unless enable() is called before the first connection opens.
+    class TraceRecorder {
+    public:
+        static TraceRecorder& instance();
+
+        // Turns tracing on; must be called before any connection is opened. Later calls are ignored.
+        // @param path: Trace file, overwritten when the process exits
+        // @return: false if the trace file can't be created
+        bool enable(const string& path);
+
+        // @return: true if enable() succeeded (cheap; safe before instance() exists)
+        static bool active() { return enabled.load(memory_order_relaxed); }
+
+        // Names the calling thread in the trace; does nothing unless tracing
+        static void nameThread(const string& name);
+
+        // Adds a span that has already ended on the calling thread; does nothing unless tracing
+        // @param name: Span name (copied)
+        // @param detail: Shown with the span (copied)
+        // @param started: When it began
+        // @param ended: When it ended
+        static void record(string_view name, string_view detail, chrono::steady_clock::time_point started,
+                           chrono::steady_clock::time_point ended);
+
+        // Waits out another connection's lock with the same back-off and limit as
+        // sqlite3_busy_timeout(BUSY_TIMEOUT_MS), recording each sleep as a span
+        static int busyWait(void* context, int retries);
+
+        // @return: The calling thread's ring, registered on first use
+        ThreadTrace& local();
+
+        // Bracket the owner's writes to its ring. Once tracing stops, beginChange refuses and
+        // the trace file is written after waiting for any change already in progress.
+        // @param trace: The calling thread's ring
+        // @return: false if tracing has stopped; nothing may be written and endChange isn't called
+        static bool beginChange(ThreadTrace& trace);
+        static void endChange(ThreadTrace& trace) { trace.changing.store(false, memory_order_release); }
+
+        // @return: Nanoseconds since tracing was enabled
+        uint64_t now() const {
+            return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - origin).count();
+        }
+
+        // Writes the trace file
+        ~TraceRecorder();
+
+    private:
+        TraceRecorder() = default;
+        void write();  // Rings to the trace file
+
+        static atomic<bool> enabled;
+        int fd = -1;                               // Trace file
+        chrono::steady_clock::time_point origin;   // Time zero of the trace
+        mutex mtx;                                 // Guards threads and the threads' names
+        vector<ThreadTrace*> threads;              // Every thread that traced anything; never freed, since
+                                                   // threads still running at exit may touch their rings
+    };
+
+    // Records the time until it goes out of scope as a span on the calling thread,
+    // nested under any span the thread has open; does nothing unless tracing
+    class TraceSpan {
+    public:
+        // @param name: Span name (copied)
+        // @param detail: Shown with the span (copied)
+        explicit TraceSpan(string_view name, string_view detail = {});
+        ~TraceSpan();
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+    private:
+        ThreadTrace* trace = nullptr;  // Calling thread's ring, or nullptr when not tracing
+        uint64_t sequence = 0;         // The span's position in the ring
+    };
+
+    // Operation metrics - Latency histograms kept per thread and merged on demand
+
+    // Timed operations; Sql covers each statement execution, from its first step to its reset
+    enum class Metric {
+        FlightExists, UserExists, IsSeatAvailable, GetTakenSeats, FindFreeSeats,
+        InsertFlight, UpdateFlight, RemoveFlight,
+        ReserveSeat, ReserveGroup, BookItinerary, ModifyBooking, CancelBooking, RemovePassenger, GroupCommit,
+        ListFlights, ListUsers, SearchRoutes, FindConnections,
+        Sql,
+        Count  // Number of metrics, not a metric
+    };
+
+    // Metric names, shown in the statistics and as trace span names
+    const char* const METRIC_NAMES[] = {
+        "flightExists", "userExists", "isSeatAvailable", "getTakenSeats", "findFreeSeats",
+        "insertFlight", "updateFlight", "removeFlight",
+        "reserveSeat", "reserveGroup", "bookItinerary", "modifyBooking", "cancelBooking", "removePassenger",
+        "groupCommit", "listFlights", "listUsers", "searchRoutes", "findConnections", "sql"};
+    static_assert(sizeof(METRIC_NAMES) / sizeof(METRIC_NAMES[0]) == static_cast<size_t>(Metric::Count), "a name per metric");
+
+    const int HISTOGRAM_SUB_BUCKET_BITS = 5;                        // 32 buckets per power of two: about 3% precision
+    const int HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BUCKET_BITS;
+    const int HISTOGRAM_MAX_EXPONENT = 44;                          // Longer than 2^45 ns (~9.8 hours) is clamped
+    const int HISTOGRAM_BUCKETS = (HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BUCKET_BITS + 2) * HISTOGRAM_SUB_BUCKETS;
+
+    // Single-writer increment: the owning thread is the only one storing to these counters
+    static inline void bump(atomic<uint64_t>& counter, uint64_t amount = 1) {
+        counter.store(counter.load(memory_order_relaxed) + amount, memory_order_relaxed);
+    }
+
+    // Merged copy of one metric's histograms
+    struct HistogramSnapshot {
+        vector<uint64_t> buckets = vector<uint64_t>(HISTOGRAM_BUCKETS);  // Observations per bucket
+        uint64_t count = 0;       // Observations
+        uint64_t totalNanos = 0;  // Sum of the latencies
+        uint64_t maxNanos = 0;    // Longest latency
+        uint64_t statements = 0;  // SQL statements run inside the operation
+        uint64_t rows = 0;        // Result rows read inside the operation
+
+        // @param fraction: Share of observations, e.g. 0.99
+        // @return: Latency in nanoseconds that this share of observations didn't exceed
+        uint64_t percentile(double fraction) const;
+    };
+
+    // Latency histogram of one metric on one thread, with HDR-style log-linear buckets:
+    // values below HISTOGRAM_SUB_BUCKETS ns get a bucket each, and every power of two
+    // above that is split into HISTOGRAM_SUB_BUCKETS equal buckets. Only the owning thread
+    // writes, so recording is a few relaxed loads and stores with no lock or locked
+    // instruction; other threads may read the counters at any time.
+    class LatencyHistogram {
+    public:
+        // Adds one observation (owning thread only)
+        // @param nanos: Latency in nanoseconds
+        // @param statements: SQL statements the operation ran
+        // @param rows: Result rows the operation read
+        void record(uint64_t nanos, uint64_t statements, uint64_t rows);
+
+        // Adds the counters into a merged snapshot
+        void mergeInto(HistogramSnapshot& total) const;
+
+        // @return: Bucket holding a value
+        static int bucketOf(uint64_t nanos);
+
+        // @return: Middle of a bucket's range, the value reported for it
+        static uint64_t bucketValue(int bucket);
+
+    private:
+        atomic<uint64_t> buckets[HISTOGRAM_BUCKETS] = {};
+        atomic<uint64_t> count{0};
+        atomic<uint64_t> totalNanos{0};
+        atomic<uint64_t> maxNanos{0};
+        atomic<uint64_t> statements{0};
+        atomic<uint64_t> rows{0};
+    };
+
+    // A statement execution in progress on a thread, timed for Metric::Sql
+    struct RunningStatement {
+        sqlite3_stmt* stmt;                         // Statement being executed
+        chrono::steady_clock::time_point started;   // Its first step
+        uint64_t rows;                              // Result rows returned so far
+    };
+
+    // One thread's histograms and SQL counters
+    struct ThreadMetrics {
+        atomic<LatencyHistogram*> histograms[static_cast<int>(Metric::Count)] = {};  // Created on first use
+        atomic<uint64_t> statements{0};  // SQL statements started on this thread (trace callback)
+        atomic<uint64_t> rows{0};        // Result rows returned on this thread (trace callback)
+        vector<RunningStatement> running;  // Executions not finished yet, innermost last (owner only)
+
+        // @return: The histogram for a metric, created on first use (owning thread only)
+        LatencyHistogram& histogram(Metric metric);
+
+        ~ThreadMetrics();
+    };
+
+    // Keeps every thread's metrics, including those of threads that have exited, and
+    // merges them when asked. The lock is only taken when a thread records its first
+    // observation and while merging.
+    class MetricsRegistry {
+    public:
+        static MetricsRegistry& instance();
+
+        // @return: The calling thread's metrics, registered on first use
+        ThreadMetrics& local();
+
+        // Merges every thread's histograms
+        // @param perMetric: Receives one snapshot per Metric
+        // @param statements: Receives the SQL statements run by every thread
+        // @param rows: Receives the result rows read by every thread
+        void snapshot(vector<HistogramSnapshot>& perMetric, uint64_t& statements, uint64_t& rows);
+
+    private:
+        mutex mtx;                                  // Guards threads
+        vector<unique_ptr<ThreadMetrics>> threads;  // Every thread that recorded anything
+    };
+
+    // Records the time until it goes out of scope, with the SQL statements and rows the
+    // calling thread ran meanwhile, in the calling thread's histogram for a metric, and
+    // as a trace span named after the metric
+    class OperationTimer {
+    public:
+        explicit OperationTimer(Metric metric);
+        ~OperationTimer();
+        OperationTimer(const OperationTimer&) = delete;
+        OperationTimer& operator=(const OperationTimer&) = delete;
+
+    private:
+        TraceSpan span;                        // Opened first and closed last, so it covers the whole operation
+        Metric metric;                         // Histogram to record in
+        ThreadMetrics& metrics;                // Calling thread's metrics
+        uint64_t statements;                   // metrics.statements when started
+        uint64_t rows;                         // metrics.rows when started
+        chrono::steady_clock::time_point started;
+    };
+
+    // SQL profiling - Time per statement and a slow-query log
+
+    // Totals for one statement, with literals replaced by ? so that executions differing
+    // only in their values are counted together
+    struct StatementProfile {
+        string sql;                // Normalized statement text
+        uint64_t count = 0;        // Executions
+        uint64_t totalNanos = 0;   // Time from first step to reset, summed
+        uint64_t maxNanos = 0;     // Longest execution
+        uint64_t rows = 0;         // Result rows returned
+        uint64_t scanSteps = 0;    // Rows visited by full table scans (SQLITE_STMTSTATUS_FULLSCAN_STEP)
+        string example;            // Text of one execution as prepared, for EXPLAIN QUERY PLAN
+    };
+
+    // Times every statement on the pooled connections through sqlite3_trace_v2 (statement
+    // start, row and profile events), aggregates the times per normalized statement on each
+    // thread, and writes each execution slower than a threshold to a slow-query log with its
+    // EXPLAIN QUERY PLAN. SQLite's own profile time has only millisecond resolution, so the
+    // time is measured from the statement's start event instead. Plans are looked up on a
+    // logger thread with its own connection, because a trace callback must not run SQL on
+    // the connection that invoked it. Off unless enable() is called before the first
+    // connection opens.
+    class SqlProfiler {
+    public:
+        static SqlProfiler& instance();
+
+        // Turns profiling on; must be called before any connection is opened. Later calls are ignored.
+        // @param slowMillis: Executions taking at least this long are logged
+        // @param logPath: Slow-query log, appended to
+        void enable(double slowMillis, const string& logPath);
+
+        // @return: true if enable() was called (cheap; safe before instance() exists)
+        static bool active() { return enabled.load(memory_order_relaxed); }
+
+        // Trace callback for one connection (installed by ConnectionPool::open)
+        static int trace(unsigned type, void* context, void* p, void* x);
+
+        // Merges every thread's totals, most total time first
+        // @param profiles: Receives one entry per normalized statement
+        void snapshot(vector<StatementProfile>& profiles);
+
+        // @return: Executions written to the slow-query log so far
+        uint64_t slowCount() const { return slowLogged.load(); }
+
+        // @return: Slow-query log path
+        const string& logPath() const { return slowLogPath; }
+
+        ~SqlProfiler();
+
+    private:
+        // One thread's totals; executions in progress are tracked by ThreadMetrics::running
+        struct ThreadProfile {
+            mutex mtx;  // Held by the owner while updating and by snapshot(); never contended otherwise
+            unordered_map<string, StatementProfile> byText;  // Totals per normalized statement
+            // Raw text and totals per statement address, at most PROFILE_KNOWN_STATEMENTS of them
+            unordered_map<sqlite3_stmt*, pair<string, StatementProfile*>> known;
+            int thread = 0;                                  // Small id shown in the slow-query log
+        };
+
+        // An execution waiting to be written to the slow-query log
+        struct SlowQuery {
+            chrono::system_clock::time_point when;  // When it finished
+            uint64_t nanos;                         // How long it took
+            int thread;                             // ThreadProfile::thread of the caller
+            string sql;                             // Text as prepared, used for the plan
+            string expanded;                        // Text with the bound values filled in
+            uint64_t scanSteps;                     // Full-scan steps it took
+            string database;                        // File of the connection that ran it
+        };
+
+        SqlProfiler() = default;
+        ThreadProfile& local();
+        void finished(sqlite3_stmt* stmt, uint64_t nanos, uint64_t rows);
+        void writeSlowQueries();        // Logger thread
+        static string normalize(const char* sql);
+
+        static atomic<bool> enabled;
+        uint64_t slowNanos = 0;         // Threshold
+        string slowLogPath;             // Log file
+        mutex mtx;                      // Guards threads and slow, and stopping
+        condition_variable slowQueued;  // Wakes the logger thread
+        vector<unique_ptr<ThreadProfile>> threads;  // Every thread that ran SQL
+        deque<SlowQuery> slow;          // Waiting for the logger
+        bool stopping = false;          // Set by the destructor
+        atomic<uint64_t> slowLogged{0}; // Entries written
+        thread logger;                  // Started by enable()
+    };
+
+    // Borrows a cached statement from the calling thread's connection for one execution.
+    // The statement is reset and its bindings cleared when the handle goes out of scope.
+    class StatementHandle {
+    public:
+        explicit StatementHandle(const string& sql);
+        ~StatementHandle();
+        StatementHandle(const StatementHandle&) = delete;
+        StatementHandle& operator=(const StatementHandle&) = delete;
+
+        sqlite3_stmt* get() const { return stmt; }
+        explicit operator bool() const { return stmt != nullptr; }
+
+    private:
+        Connection* conn = nullptr;   // Connection that compiled the statement
+        sqlite3_stmt* stmt = nullptr; // Borrowed statement
+        bool cached = true;           // False for one-off statements finalized on destruction
+    };
+
+    // Runtime counters of the checkpoint manager
+    struct StorageStats {
+        uint64_t commits = 0;              // Commits reported by the WAL hook
+        int walFrames = 0;                 // Frames in the WAL after the latest commit
+        uint64_t passiveCheckpoints = 0;   // Checkpoints run while bookings were active
+        uint64_t truncateCheckpoints = 0;  // Checkpoints that reset the WAL during quiet periods
+        uint64_t framesCheckpointed = 0;   // Frames copied back into database.db
+        uint64_t busyCheckpoints = 0;      // Checkpoints that couldn't finish because of readers
+    };
+
+    // Keeps the write-ahead log short without stalling bookings.
+    // Every pooled connection reports its commits through sqlite3_wal_hook. A background
+    // thread runs a passive checkpoint once the WAL holds passiveCheckpointFrames frames
+    // and a truncating checkpoint once no commit happened for quietPeriodMs.
+    class CheckpointManager {
+    public:
+        // Returns the process-wide manager, starting its thread on first use
+        static CheckpointManager& instance();
+
+        // Records a commit (called from the WAL hook)
+        // @param walFrames: Number of frames now in the WAL
+        void noteCommit(int walFrames);
+
+        // Returns a snapshot of the counters
+        StorageStats stats();
+
+        ~CheckpointManager();  // Stops the background thread
+
+    private:
+        CheckpointManager();
+        void run();                        // Background thread main loop
+        bool checkpoint(int mode);         // Runs one checkpoint on the thread's connection
+
+        mutex mtx;                         // Guards stopping and the counters below
+        condition_variable wake;           // Signalled on shutdown or when the WAL grows large
+        bool stopping = false;
+        StorageStats counters;
+        chrono::steady_clock::time_point lastCommit = chrono::steady_clock::now();
+        thread worker;                     // Runs checkpoints
+    };
+
+    // Seat occupancy of one flight, one bit per seat (set = taken).
+    // Seat n is bit n-1 of the bitmap; bits past the flight's capacity stay set so that
+    // word scans never report them as free. The words are atomic: a seat is claimed with
+    // fetch_or, so when several threads go for the same seat exactly one of them sees the
+    // bit clear and wins, without any lock or database round trip. Seats booked outside
+    // 1..capacity by older versions of the program are kept in a separate locked list.
+    class SeatMap {
+    public:
+        // @param capacity: Flights.totalTickets
+        // @param takenSeats: Seats already booked
+        SeatMap(int capacity, const vector<int>& takenSeats);
+
+        int capacity() const { return seatCount; }
+
+        // @return: true if seat is booked (or outside the flight's capacity)
+        bool isTaken(int seat) const;
+
+        // Atomically takes a free seat
+        // @param seat: Seat number in 1..capacity
+        // @return: true if this call took the seat, false if it was already taken
+        bool tryClaim(int seat);
+
+        // Atomically frees a seat (also releases legacy out-of-range bookings)
+        // @param seat: Seat number
+        void release(int seat);
+
+        // @return: Booked seat numbers in ascending order
+        vector<int> takenSeats() const;
+
+        // @return: Lowest free seat number, or 0 if the flight is full
+        int firstFreeSeat() const;
+
+        // @return: Number of free seats, adjacent or not (a snapshot, like firstFreeRun)
+        int freeSeatCount() const;
+
+        // Finds the lowest run of adjacent free seats, for seating a group together
+        // The result is a snapshot: claim the seats with tryClaim before relying on it
+        // @param count: Number of adjacent seats needed
+        // @return: First seat of the run, or 0 if there is no such run
+        int firstFreeRun(int count) const;
+
+    private:
+        int seatCount;                      // Number of seats covered by the bitmap
+        vector<atomic<uint64_t>> words;     // Occupancy bits, 64 seats per word
+        vector<int> outOfRangeSeats;        // Legacy bookings outside 1..capacity
+        mutable mutex legacyMtx;            // Guards outOfRangeSeats only
+    };
+
+    // Per-flight seat maps, loaded from the Users table the first time a flight is asked
+    // about and then kept current by the reservation engine, so seat checks and seat
+    // listings never touch the database. Every map is dropped when the flight catalog
+    // sees that another process may have written.
+    class SeatIndex {
+    public:
+        // Returns the process-wide index
+        static SeatIndex& instance();
+
+        // Returns the flight's seat map, loading it on first use
+        // @param flightNumber: Flight to look up
+        // @return: The seat map, or nullptr if the flight doesn't exist
+        shared_ptr<SeatMap> get(const string& flightNumber);
+
+        // Records a committed booking or cancellation
+        // Bookings normally claimed their seat already; recording them again keeps a map
+        // that was being (re)loaded at the time of the commit correct
+        // @param flightNumber: Flight whose seat changed
+        // @param seat: Seat number
+        // @param taken: true for a booking, false for a cancellation
+        void update(const string& flightNumber, int seat, bool taken);
+
+        // Drops a flight's map so it is reloaded on next use (after flight changes)
+        // @param flightNumber: Flight to forget
+        void invalidate(const string& flightNumber);
+
+        // Drops every map
+        void clear();
+
+    private:
+        shared_mutex mtx;                                  // Guards both maps below
+        unordered_map<string, shared_ptr<SeatMap>> maps;   // Loaded flights
+        unordered_map<string, uint64_t> versions;          // Changes seen per flight, to detect
+                                                           // updates racing with a load
+        uint64_t generation = 0;                           // Bumped by clear()
+    };
+
+    // In-memory copy of the Flights table, keyed by flight number.
+    // Filled at startup and kept current without polling: an update hook on every pooled
+    // connection records which Flights rows a transaction touched, and the committing
+    // thread re-reads exactly those rows right after the commit. Writes made by other
+    // processes are noticed through PRAGMA data_version, checked at most every
+    // CATALOG_CHECK_INTERVAL_MS, and trigger a full reload (and a reload of the seat maps).
+    class FlightCatalog {
+    public:
+        // Returns the process-wide catalog
+        static FlightCatalog& instance();
+
+        // Reads the whole Flights table
+        // @return: true on success
+        bool load();
+
+        // Copies a flight out of the catalog
+        // @param flightNumber: Flight to look up
+        // @param flight: Receives the flight's data if found
+        // @return: true if the flight exists
+        bool find(const string& flightNumber, Flight& flight);
+
+        // @return: true if the flight exists
+        bool contains(const string& flightNumber);
+
+        // Finds flights with tickets left between two cities, most tickets left first
+        // @param from: Origin, or the start of its name when fromPrefix is set
+        // @param fromPrefix: Match every origin that begins with from
+        // @param to: Destination, or the start of its name when toPrefix is set; empty matches any
+        // @param toPrefix: Match every destination that begins with to
+        // @param found: Receives the matching flights
+        // @return: false on a database error
+        bool searchRoutes(const string& from, bool fromPrefix, const string& to, bool toPrefix,
+                          vector<Flight>& found);
+
+        // Finds itineraries of up to maxLegs flights from one city to another where every
+        // leg has tickets left and no city is visited twice. Itineraries with fewer legs
+        // come first. Legs are matched by city only; the schema has no departure times.
+        // @param from: Origin city
+        // @param to: Destination city
+        // @param maxLegs: Most flights in one itinerary
+        // @param maxResults: Most itineraries to return
+        // @param found: Receives the itineraries, each a list of flights in travel order
+        // @return: false on a database error
+        bool findConnections(const string& from, const string& to, int maxLegs, size_t maxResults,
+                             vector<vector<Flight>>& found);
+
+        // Re-reads rows written by a transaction that just committed
+        // @param rowids: Flights rowids reported by the update hook
+        void refreshRows(const vector<sqlite3_int64>& rowids);
+
+        // Reloads the catalog and drops the seat maps if another process may have written
+        // since the last check (PRAGMA data_version); checks at most every CATALOG_CHECK_INTERVAL_MS
+        void checkExternalChanges();
+
+        // Counts a commit made by this process, so data_version changes it caused
+        // aren't mistaken for another process's writes
+        void noteLocalCommit() { localCommits.fetch_add(1, memory_order_relaxed); }
+
+        // @return: Number of flights cached
+        size_t size();
+
+        // @return: Number of full reloads (startup included)
+        uint64_t reloads() const { return fullLoads.load(memory_order_relaxed); }
+
+    private:
+        // Flights as edges between cities, updated one flight at a time
+        struct RouteGraph {
+            map<string, map<string, set<string>>> departures;  // Origin -> destination -> flight numbers,
+                                                               // ordered so city prefixes are ranges
+            unordered_map<string, set<string>> arrivals;       // Destination -> origins with a flight to it
+
+            void add(const Flight& flight);
+            void remove(const Flight& flight);
+        };
+
+        static void connect(const RouteGraph& routes, const unordered_map<string, Flight>& flights,
+                            const string& from, const string& to, int maxLegs, size_t maxResults,
+                            vector<vector<Flight>>& found);
+
+        shared_mutex mtx;                                   // Guards the maps and changeSeq
+        unordered_map<string, Flight> flights;              // Flight number -> row
+        RouteGraph routes;                                  // Flights by city pair
+        unordered_map<sqlite3_int64, string> numberByRowid; // rowid -> flight number
+        uint64_t changeSeq = 0;                             // Bumped by refreshRows, to detect
+                                                            // row refreshes racing with load()
+        atomic<uint64_t> localCommits{0};                   // Commits made by this process
+        atomic<int64_t> nextCheck{0};                       // steady_clock time of the next check
+        atomic<int64_t> lastLoad{0};                        // steady_clock time of the last load()
+        atomic<bool> suspect{false};                        // data_version moved during our own commits
+        atomic<uint64_t> fullLoads{0};
+    };
+
+    // Groups statements on the calling thread's connection into one atomic unit.
+    // Opens with BEGIN IMMEDIATE so the write lock is taken up front, or with a SAVEPOINT
+    // when a transaction is already open so that transactions nest. Anything not
+    // committed is rolled back when the object goes out of scope.
+    class Transaction {
+    public:
+        Transaction();
+        ~Transaction();
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+        // @return: true if the transaction (or savepoint) was opened
+        bool active() const { return open; }
+
+        // Makes the changes permanent (or releases the savepoint into the outer transaction)
+        // @return: true on success; on failure the changes are rolled back
+        bool commit();
+
+        // Discards every change made since the transaction was opened
+        void rollback();
+
+    private:
+        bool nested = false;  // Implemented as a savepoint inside an outer transaction
+        bool open = false;    // Still waiting for commit() or rollback()
+    };
+
+    // Read-only memory mapping of a whole file, unmapped on destruction
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // Maps a file
+        // @param path: File to map
+        // @return: true if the file could be mapped (an empty file maps to zero bytes)
+        bool open(const string& path);
+
+        const char* data() const { return bytes; }
+        size_t size() const { return length; }
+
+    private:
+        const char* bytes = nullptr;  // Start of the mapping
+        size_t length = 0;            // Mapped bytes
+    };
+
+    // Splits CSV text into records without copying it (RFC 4180: comma separated,
+    // double-quoted fields may contain commas, newlines and "" for a quote).
+    // Fields point into the input; only quoted fields containing "" are copied.
+    class CsvReader {
+    public:
+        CsvReader(const char* data, size_t size) : pos(data), end(data + size) {}
+
+        // Reads the next record, skipping blank lines
+        // @param fields: Receives the fields; valid until the next call
+        // @return: false at end of input. A malformed record returns true with error() set
+        bool next(vector<string_view>& fields);
+
+        // @return: Line number on which the last record started
+        size_t line() const { return recordLine; }
+
+        // @return: Raw text of the last record, without its line ending
+        string_view record() const { return recordText; }
+
+        // @return: Why the last record couldn't be parsed, or empty
+        const string& error() const { return errorText; }
+
+    private:
+        const char* pos;             // Next unread byte
+        const char* end;             // End of input
+        size_t nextLine = 1;         // Line number of pos
+        size_t recordLine = 0;       // Line number where the last record started
+        string_view recordText;      // Raw text of the last record
+        string errorText;            // Parse error for the last record
+        deque<string> unescaped;     // Copies of quoted fields that contained ""
+    };
+
+    // Collects output in one large buffer and hands it to the kernel in big writes
+    class BufferedWriter {
+    public:
+        // @param fd: Open file descriptor to write to (not closed by the writer)
+        explicit BufferedWriter(int fd) : fd(fd), buffer(EXPORT_BUFFER_BYTES) {}
+        ~BufferedWriter() { flush(); }
+        BufferedWriter(const BufferedWriter&) = delete;
+        BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+        void write(const char* data, size_t size);
+        void write(string_view text) { write(text.data(), text.size()); }
+        void put(char c) {
+            if (used == buffer.size()) flush();
+            buffer[used++] = c;
         }
+        void writeInt(sqlite3_int64 value);
+
+        // Writes out everything buffered so far
+        // @return: false if any write has failed
+        bool flush();
+
+    private:
+        int fd;               // Destination
+        vector<char> buffer;  // Pending output
+        size_t used = 0;      // Bytes of buffer in use
+        bool failed = false;  // A write to fd failed
     };
 
     // Database functions - Interface for all database operations in the system
 
-    // Initializes the database by creating required tables if they don't exist
-    // Creates both Flights and Users tables with proper schema constraints
-    void initializeDatabase();
+    // Returns the database handle bound to the calling thread
+    // Opens it through the ConnectionPool on first use; later calls reuse the same handle
+    // @return: Open database handle, or nullptr if the database can't be opened
+    sqlite3* getConnection();
+
+    // Initializes the database, creating the tables or applying any schema migrations
+    // the file hasn't had yet (tracked in PRAGMA user_version)
+    // @param announce: Print a confirmation once the database is ready
+    void initializeDatabase(bool announce = true);
 
     // Executes a SQL command that doesn't return results (INSERT/UPDATE/DELETE/CREATE)
     // @param sql: The SQL command string to execute
@@ -75,29 +1038,357 @@
     // @return: true if seat is available, false if already taken
     bool isSeatAvailable(const string& flightNumber, int seatNumber);
 
-    // Callback function that processes each row of flight query results
-    //Processes each row of flight data from database queries.
-    // @param data: User-provided pointer for additional context
-    // @param argc: Number of columns in the result row
-    // @param argv: Array of column values as strings
-    // @param azColName: Array of column names
-    // @return: 0 to continue processing, non-zero to abort
-    int flightCallback(void* data, int argc, char** argv, char** azColName);
-
-    // Callback function that processes each row of user query results
-    //Processes each row of user data from database queries.
-    // @param data: User-provided pointer for additional context
-    // @param argc: Number of columns in the result row
-    // @param argv: Array of column values as strings
-    // @param azColName: Array of column names
-    // @return: 0 to continue processing, non-zero to abort
-    int userCallback(void* data, int argc, char** argv, char** azColName);
-
     // Retrieves all occupied seat numbers for a specific flight
     // @param flightNumber: The flight to check for taken seats
     // @return: Vector containing all occupied seat numbers
     vector<int> getTakenSeats(const string& flightNumber);
 
+    // Reservation engine - Transactional booking operations shared by every caller
+
+    // Outcome of a booking or cancellation
+    enum class ReservationResult {
+        Ok,             // Booking stored / cancellation applied
+        NoFlight,       // Flight number doesn't exist
+        SoldOut,        // Flight has no available tickets left
+        SeatTaken,      // Seat already booked on that flight
+        InvalidSeat,    // Seat number outside 1..totalTickets
+        DuplicateUser,  // Passenger already holds a seat on this flight
+        NoReservation,  // User ID isn't on file
+        NoBookings,     // Passenger is on file but holds no matching reservation
+        FlightExists,   // Flight number already in use
+        RepeatedFlight, // Itinerary lists the same flight twice
+        AmbiguousBooking, // Passenger has several bookings and no flight was given
+        NameMismatch,   // User ID is on file under a different name
+        NoAdjacentSeats, // Enough seats are free for a group, but not side by side
+        Error           // Database error; nothing was changed
+    };
+
+    // Returns a message suitable for showing to the agent
+    // @param result: Outcome to describe
+    const char* describe(ReservationResult result);
+
+    // Takes user.seatNumber on user.flightNumber in the in-memory seat map.
+    // Only one caller can win a seat; the others get SeatTaken at once, without
+    // touching the database. The winner must then call persistReservation.
+    // @param user: Flight and seat to claim
+    // @return: Ok if this caller now owns the seat, otherwise NoFlight, InvalidSeat or SeatTaken
+    ReservationResult claimSeat(const User& user);
+
+    // Stores a booking whose seat was claimed with claimSeat, in one transaction.
+    // The ticket counter is decremented with a guarded UPDATE (availableTickets > 0),
+    // so concurrent bookers can never oversell a flight. The claim is released if
+    // the booking can't be stored.
+    // @param user: Passenger, flight and claimed seat
+    // @return: Ok, or the reason nothing was booked
+    ReservationResult persistReservation(const User& user);
+
+    // Claims and stores a booking: claimSeat followed by persistReservation
+    // @param user: Passenger, flight and seat to book
+    // @return: Ok, or the reason nothing was booked
+    ReservationResult reserveSeat(const User& user);
+
+    // Picks seats for automatic assignment from the flight's seat map
+    // @param flightNumber: Flight to search
+    // @param count: Number of adjacent seats wanted (1 for a single passenger)
+    // @return: First seat of the lowest free run, or 0 if none (or no such flight)
+    int findFreeSeats(const string& flightNumber, int count);
+
+    // Books adjacent seats for a group on one flight, all or nothing, in one transaction.
+    // Seats are picked with findFreeSeats and picked again if another agent takes one first.
+    // @param passengers: Passengers with userID, name and flightNumber set; seatNumber is filled in
+    // @return: Ok, SoldOut if fewer seats than passengers are free, NoAdjacentSeats if enough are
+    //          free but not side by side, or the reason nobody was booked
+    ReservationResult reserveGroup(vector<User>& passengers);
+
+    // Books one seat on each of several flights, all or nothing, in one transaction.
+    // Seats are claimed in flight number order, whatever the order of travel, so two
+    // agents booking overlapping itineraries contend on the same first flight instead
+    // of each holding a seat the other needs. A leg with seatNumber 0 gets the lowest
+    // free seat.
+    // @param legs: One booking per flight, normally all for one passenger; seatNumber is
+    //              filled in for automatic legs
+    // @return: Ok, or the reason nothing was booked
+    ReservationResult bookItinerary(vector<User>& legs);
+
+    // Moves one of a passenger's bookings to user.flightNumber/user.seatNumber and renames
+    // the passenger in one transaction, moving a ticket between flights if the flight changes
+    // @param user: New name, flight and seat for user.userID
+    // @param fromFlight: Flight of the booking to move; may be empty if the passenger has only one
+    // @return: Ok, NoReservation if there is no such passenger, NoBookings if they hold no matching
+    //          booking, AmbiguousBooking if fromFlight is needed, or the reason nothing was changed
+    ReservationResult modifyBooking(const User& user, const string& fromFlight = "");
+
+    // Removes a passenger's bookings and returns the seats to their flights in one transaction
+    // @param userID: Passenger whose bookings are cancelled
+    // @param flightNumber: Only cancel the booking on this flight; empty cancels them all
+    // @return: Ok, NoReservation if there is no such passenger, NoBookings if they hold no matching
+    //          booking, or Error
+    ReservationResult cancelBooking(const string& userID, const string& flightNumber = "");
+
+    // Cancels all of a passenger's bookings and deletes the passenger, in one transaction
+    // @param userID: Passenger to delete
+    // @return: Ok, NoReservation if there is no such passenger, or Error
+    ReservationResult removePassenger(const string& userID);
+
+    // Collects bookings and cancellations from many threads and commits them in groups.
+    // A single writer thread waits until GROUP_COMMIT_MAX_OPS operations are queued or
+    // GROUP_COMMIT_WINDOW_US microseconds have passed since the first one arrived, then
+    // applies them in one transaction (each in its own savepoint) so that a single
+    // commit covers the whole group. Every caller gets its own result through a future.
+    class BookingQueue {
+    public:
+        // Returns the process-wide queue, starting its writer thread on first use
+        static BookingQueue& instance();
+
+        // Claims the seat right away (see claimSeat) and queues persistReservation(user)
+        // @param user: Passenger, flight and seat to book
+        // @return: Future completed once the group containing the booking is committed
+        future<ReservationResult> submitReservation(const User& user);
+
+        // Queues cancelBooking(userID, flightNumber)
+        // @param userID: Passenger whose bookings are cancelled
+        // @param flightNumber: Only cancel the booking on this flight; empty cancels them all
+        // @return: Future completed once the group containing the cancellation is committed
+        future<ReservationResult> submitCancellation(const string& userID, const string& flightNumber = "");
+
+        ~BookingQueue();  // Commits what is still queued and stops the writer
+
+    private:
+        struct Operation {
+            bool cancel;                        // cancelBooking instead of reserveSeat
+            User user;                          // Booking details (userID and flightNumber for cancellations)
+            promise<ReservationResult> result;  // Completed after the group commit
+        };
+
+        BookingQueue();
+        future<ReservationResult> submit(Operation op);
+        void run();                       // Writer thread main loop
+        void commitGroup(vector<Operation>& group);
+
+        mutex mtx;                        // Guards queue and stopping
+        condition_variable queued;        // Signalled when operations arrive or on shutdown
+        deque<Operation> queue;           // Operations waiting for the next group
+        bool stopping = false;            // Set by the destructor
+        thread writer;                    // Applies and commits groups
+    };
+
+    // Flight operations - Non-interactive flight changes shared by the menu and batch mode
+
+    // Adds a flight
+    // @param flight: Flight to store
+    // @return: Ok, FlightExists, or Error
+    ReservationResult insertFlight(const Flight& flight);
+
+    // Replaces a flight's airline, route and ticket counts
+    // @param flight: New data for flight.flightNumber
+    // @return: Ok, NoFlight, or Error
+    ReservationResult updateFlight(const Flight& flight);
+
+    // Deletes a flight and every reservation on it in one transaction
+    // @param flightNumber: Flight to delete
+    // @return: Ok, NoFlight, or Error
+    ReservationResult removeFlight(const string& flightNumber);
+
+    // Listings - Keyset pagination over the primary keys
+
+    // Reads the flights that follow a key, in flight number order
+    // Seeks the primary key index to the key, so any page costs the same as the first
+    // @param after: Last flight number of the previous page, or empty for the first page
+    // @param limit: Maximum rows to return
+    // @param page: Receives the rows and the cursor for the next page
+    // @return: false on a database error
+    bool listFlights(const string& after, size_t limit, Page<Flight>& page);
+
+    // Reads the passengers that follow a key, in user ID order, one row per booking
+    // (a passenger without bookings has one row with an empty flight)
+    // @param after: Last user ID of the previous page, or empty for the first page
+    // @param limit: Maximum passengers to return
+    // @param page: Receives the rows and the cursor for the next page
+    // @return: false on a database error
+    bool listUsers(const string& after, size_t limit, Page<User>& page);
+
+    // Searches flights by city pair, reading a trailing * on either city as a prefix match
+    // @param from: Origin, e.g. "New York" or "New*"
+    // @param to: Destination in the same form; empty matches any
+    // @param found: Receives flights with tickets left, most tickets left first
+    // @return: false on a database error
+    bool searchRoutes(const string& from, const string& to, vector<Flight>& found);
+
+    // Batch mode - Non-interactive command files
+
+    // Runs every command in a command file, printing one status line per command and
+    // a throughput summary. Commands share the calling thread's connection; changes are
+    // committed BATCH_TRANSACTION_SIZE at a time and their status lines are printed once
+    // their group commits. Read-only commands (seats, routes, connections, listings,
+    // stats, profile, export) commit the open group first and run outside it. One command per line:
+    //   add-flight <flight> <airline> <from> <to> <totalTickets>
+    //   modify-flight <flight> <airline> <from> <to> <totalTickets> <availableTickets>
+    //   delete-flight <flight>
+    //   book <userID> <name> <flight> <seat|auto>
+    //   modify <userID> <name> <flight> <seat> [<fromFlight>]
+    //   cancel <userID> [<flight>]
+    //   delete-user <userID>
+    //   group <flight> <userID> <name> [<userID> <name> ...]
+    //   itinerary <userID> <name> <flight>[:<seat>] [<flight>[:<seat>] ...]
+    //   seats <flight>
+    //   routes <from> [<to>]      (a trailing * on a city matches by prefix)
+    //   connections <from> <to> [<maxLegs>]
+    //   list-flights [<limit> [<after>]]
+    //   list-users [<limit> [<after>]]
+    //   stats                     (latency percentiles per operation so far)
+    //   profile                   (time per SQL statement; needs --profile)
+    //   export <flights|users> <csv|jsonl> <file> [filters]   (see runExport)
+    // Arguments containing spaces are written in double quotes; # starts a comment.
+    // @param path: Command file, or "-" for standard input
+    // @return: 0 if every command succeeded, 1 otherwise
+    int runBatch(const string& path);
+
+    // Bulk import - Loading flight schedules and bookings from CSV files
+
+    // Counters reported by an import
+    struct ImportStats {
+        size_t rows = 0;      // Data rows read (header excluded)
+        size_t imported = 0;  // Rows stored
+        size_t rejected = 0;  // Rows written to the reject file
+    };
+
+    // Imports flights from CSV with columns
+    //   flightNumber,airlineName,startingPoint,destination,totalTickets[,availableTickets]
+    // An optional header row is skipped. Rows are inserted through cached statements
+    // and committed IMPORT_CHUNK_ROWS at a time; invalid or duplicate rows go to the
+    // reject file as "line,reason,record".
+    // @param path: CSV file to import
+    // @param rejectPath: File for rejected rows (created only if a row is rejected)
+    // @param stats: Receives the row counts
+    // @return: false if the file can't be read or a chunk fails to commit
+    bool importFlights(const string& path, const string& rejectPath, ImportStats& stats);
+
+    // Imports bookings from CSV with columns userID,name,flightNumber,seatNumber
+    // The first row for a user ID creates the passenger; each stored booking takes a ticket
+    // from its flight. Rows naming an unknown flight, a seat outside the flight, a taken
+    // seat, a sold-out flight or a flight the passenger is already on are rejected. Chunking and the reject file work as for importFlights.
+    // @param path: CSV file to import
+    // @param rejectPath: File for rejected rows (created only if a row is rejected)
+    // @param stats: Receives the row counts
+    // @return: false if the file can't be read or a chunk fails to commit
+    bool importBookings(const string& path, const string& rejectPath, ImportStats& stats);
+
+    // Runs an import from the command line and prints its summary
+    // @param kind: "flights" or "bookings"
+    // @param path: CSV file to import
+    // @param rejectPath: Reject file, or empty for <path>.rejects.csv
+    // @return: 0 if every row was imported, 1 otherwise
+    int runImport(const string& kind, const string& path, const string& rejectPath);
+
+    // Export - Streaming dumps of the Flights and Users tables
+
+    // Output formats for exports
+    enum class ExportFormat {
+        Csv,        // Header row, then one comma-separated row per record
+        JsonLines   // One JSON object per line
+    };
+
+    // Row filters for exports; empty fields match everything
+    struct ExportFilter {
+        string flightNumber;   // Flights: this flight; Users: passengers on this flight
+        string airlineName;    // Flights only
+        string startingPoint;  // Flights only
+        string destination;    // Flights only
+    };
+
+    // Streams flights matching a filter straight from the database into a writer,
+    // so memory use doesn't grow with the table
+    // @param out: Destination
+    // @param format: Output format
+    // @param filter: Rows to include
+    // @param rows: Receives the number of rows written
+    // @return: false on a database error
+    bool exportFlights(BufferedWriter& out, ExportFormat format, const ExportFilter& filter, size_t& rows);
+
+    // Streams users matching a filter (only flightNumber applies) into a writer
+    // @param out: Destination
+    // @param format: Output format
+    // @param filter: Rows to include
+    // @param rows: Receives the number of rows written
+    // @return: false on a database error
+    bool exportUsers(BufferedWriter& out, ExportFormat format, const ExportFilter& filter, size_t& rows);
+
+    // Runs an export described by command-line style arguments:
+    //   <flights|users> <csv|jsonl> <file|-> [--flight F] [--airline A] [--from X] [--to Y]
+    // Progress goes to standard error so that "-" streams clean data to standard output.
+    // @param args: Arguments after --export
+    // @return: 0 on success, 1 on a usage, file or database error
+    int runExport(const vector<string>& args);
+
+    // Benchmarks - Latency and throughput of the database helpers
+
+    // Size of the synthetic database and of each measurement
+    struct BenchConfig {
+        string dbFile = "bench.db";              // Scratch database, recreated on every run
+        string outputFile = "bench_output.txt";  // Machine-readable results
+        int flights = 1000;                      // Flights seeded
+        int seats = 200;                         // Tickets per flight
+        int passengers = 100000;                 // Passengers seeded, one booking each, spread over the flights
+        int ops = 20000;                         // Calls measured per benchmark
+        int queuedOps = 1000;                    // Calls measured per group-commit queue benchmark (at most ops);
+                                                 // one caller at a time waits out the whole window on each
+        unsigned seed = 1;                       // Random seed, so that runs are repeatable
+    };
+
+    // Seeds a scratch database and times flightExists, userExists, isSeatAvailable,
+    // getTakenSeats, reserveSeat, cancelBooking (both called directly, bypassing the
+    // group-commit queue), submitBooking and submitCancellation (through the queue, as the
+    // menu books and cancels), displayFlights and displayUsers on it, one call at a
+    // time. Prints a summary table and writes the results to the output
+    // file as tab-separated lines: benchmark, ops, seconds, ops/s, then the mean, p50,
+    // p90, p99, p99.9 and max latency in microseconds.
+    // @param args: Options after --bench: --db, --output, --flights, --seats,
+    //              --passengers, --ops, --queued-ops, --seed, each followed by its value
+    // @return: 0 on success, 1 on a usage or database error
+    int runBench(const vector<string>& args);
+
+    // Load generation - Many booking agents at once on a scratch database
+
+    // Shape of a simulated load
+    struct LoadConfig {
+        string dbFile = "loadgen.db";  // Scratch database, recreated on every run
+        int flights = 1000;            // Flights seeded
+        int seats = 200;               // Tickets per flight
+        int passengers = 100000;       // Bookings seeded, shared out among the agents to cancel and modify
+        size_t threads = 8;            // Concurrent agents
+        double seconds = 10;           // How long to run
+        double rate = 0;               // Target operations/s over all agents; 0 runs closed loop
+        double zipf = 0.99;            // Skew of flight popularity: flight k is picked with weight 1/k^zipf
+        int mix[4] = {40, 20, 10, 30}; // Weights of book, cancel, modify and seats operations
+        unsigned seed = 1;             // Random seed
+    };
+
+    // Runs booking agents on a scratch database and reports, per operation, throughput,
+    // p50/p99/p99.9 latency, seat conflicts and retries. Operations go through the same
+    // paths as the menu: book (lowest free seat, through the group-commit queue, picked
+    // again when another agent wins the seat), cancel (through the queue), modify (moves
+    // a booking to another flight) and seats (getTakenSeats). Flights are drawn from a
+    // Zipf distribution, so that a few flights take most of the traffic. With a target
+    // rate each agent starts operations on a fixed schedule (open loop) and latency is
+    // counted from the scheduled start, so a stalled database shows up as queueing delay.
+    // @param args: Options after --loadgen: --db, --flights, --seats, --passengers,
+    //              --threads, --seconds, --rate, --zipf, --mix book:N,cancel:N,modify:N,seats:N, --seed
+    // @return: 0 on success, 1 on a usage or database error
+    int runLoadGen(const vector<string>& args);
+
+    // Query plan checks - No full table scans on the statements the application runs
+
+    // Seeds a scratch database with profiling on, runs every batch command, the importers
+    // and the exports against it, then looks up EXPLAIN QUERY PLAN for each distinct
+    // statement that was executed. A statement whose plan scans a whole table (SCAN
+    // rather than SEARCH through an index) fails the check unless PLAN_SCAN_ALLOWED
+    // lists it, and so does one that can't be explained unless PLAN_UNEXPLAINABLE
+    // lists it, or a workload command or importer that fails.
+    // @param args: Options after --check-plans: --db, --flights, --seats, --passengers,
+    //              each followed by its value, and --verbose to print every plan
+    // @return: 0 if the workload ran and every statement passed, 1 otherwise
+    int runPlanCheck(const vector<string>& args);
+
     // Management functions - Core operations for the airline reservation system
 
     // Adds a new flight to the system
@@ -140,18 +1431,109 @@
     // Frees up the seat and updates flight availability
     void cancelReservation();
 
-    // Displays all available flights
-    // Shows complete flight information in formatted table
-    // Includes availability status for each flight
-    void displayFlights();
+    // Books several passengers on one flight in adjacent, automatically chosen seats
+    // Prompts for the flight, group size and each passenger's ID and name
+    void makeGroupReservation();
 
-    // Lists all registered passengers
+    // Prints storage configuration, checkpoint counters and statement cache counters
+    void displayStorageStats();
+
+    // Prints, for each timed operation and for SQL statements, the count, mean and
+    // percentile latencies and the statements run and rows read per call, merged
+    // over every thread, followed by process-wide statement and row totals
+    void displayOperationStats();
+
+    // Prints the statements seen while profiling (--profile), most total time first,
+    // with executions, total, mean and max time, rows returned and full-scan steps
+    void displaySqlProfile();
+
+    // Lists flights with tickets left between two cities, most tickets left first
+    // Prompts for origin and destination; a trailing * matches city names by prefix
+    void searchRoutesMenu();
+
+    // Books a passenger on several flights at once, all or nothing
+    // Prompts for the passenger and each leg's flight and seat (0 for automatic)
+    void makeItineraryReservation();
+
+    // Lists itineraries of up to CONNECTION_MAX_LEGS flights between two cities
+    // Prompts for origin and destination; every leg shown has tickets left
+    void findConnectionsMenu();
+
+    // Displays all available flights
+    // Shows complete flight information in formatted table
+    // Pages through LIST_PAGE_SIZE flights at a time until the user stops
+    void displayFlights();
+
+    // Lists all registered passengers
     // Shows user details with their current bookings
-    // Formatted for easy readability
+    // Pages through LIST_PAGE_SIZE users at a time until the user stops
     void displayUsers();
 
-    int main() {
-        initializeDatabase();
+    int main(int argc, char* argv[]) {
+        // SQL profiling and tracing can precede any mode, in either order:
+        //   airline [--profile <ms> [--slow-log <file>]] [--trace <file.json>] ...
+        while (argc >= 3) {
+            string option = argv[1];
+            int used = 2;  // Arguments taken by the option, shifted off before the mode is chosen
+            if (option == "--profile") {
+                char* end = nullptr;
+                double slowMillis = strtod(argv[2], &end);
+                if (*end != '\0' || slowMillis < 0) {
+                    cerr << "Usage: --profile <slow-query ms> [--slow-log <file>] [mode arguments]" << endl;
+                    return 1;
+                }
+                string logPath = "slow_queries.log";
+                if (argc >= 5 && string(argv[3]) == "--slow-log") {
+                    logPath = argv[4];
+                    used = 4;
+                }
+                SqlProfiler::instance().enable(slowMillis, logPath);
+            } else if (option == "--trace") {
+                if (!TraceRecorder::instance().enable(argv[2])) {
+                    cerr << "Can't create trace file: " << argv[2] << endl;
+                    return 1;
+                }
+            } else {
+                break;
+            }
+            argv[used] = argv[0];
+            argv += used;
+            argc -= used;
+        }
+
+        // Benchmarks seed their own scratch database: airline --bench [options]
+        if (argc >= 2 && string(argv[1]) == "--bench") {
+            return runBench(vector<string>(argv + 2, argv + argc));
+        }
+
+        // Query plan regression check on a scratch database: airline --check-plans [options]
+        if (argc >= 2 && string(argv[1]) == "--check-plans") {
+            return runPlanCheck(vector<string>(argv + 2, argv + argc));
+        }
+
+        // Simulated booking agents on a scratch database: airline --loadgen [options]
+        if (argc >= 2 && string(argv[1]) == "--loadgen") {
+            return runLoadGen(vector<string>(argv + 2, argv + argc));
+        }
+
+        // Exports may stream to standard output, so they skip the startup message
+        bool exporting = argc >= 2 && string(argv[1]) == "--export";
+        initializeDatabase(!exporting);
+
+        // Non-interactive mode: airline --batch <file>
+        if (argc == 3 && string(argv[1]) == "--batch") {
+            return runBatch(argv[2]);
+        }
+
+        // Streaming export: airline --export <flights|users> <csv|jsonl> <file|-> [filters]
+        if (exporting) {
+            return runExport(vector<string>(argv + 2, argv + argc));
+        }
+
+        // Bulk import: airline --import <flights|bookings> <file.csv> [rejects.csv]
+        if ((argc == 4 || argc == 5) && string(argv[1]) == "--import") {
+            return runImport(argv[2], argv[3], argc == 5 ? argv[4] : "");
+        }
         
         int choice;
         do {
@@ -163,10 +1545,18 @@
             cout << "5. Display Flights\n";
             cout << "6. Display Users\n";
             cout << "7. Show Available Seats\n";
+            cout << "8. Storage Statistics\n";
+            cout << "9. Group Reservation\n";
+            cout << "10. Search Routes\n";
+            cout << "11. Find Connections\n";
+            cout << "12. Book Itinerary\n";
+            cout << "13. Operation Statistics\n";
+            cout << "14. SQL Profile\n";
             cout << "0. Exit\n";
             cout << "Enter your choice: ";
             cin >> choice;
             cin.ignore(); // Clear newline character
+            TraceSpan span("menu " + to_string(choice));  // Includes the time spent answering the option's prompts
 
             switch (choice) {
                 case 1: {
@@ -221,6 +1611,27 @@
                     cout << endl;
                     break;
                 }
+                case 8:
+                    displayStorageStats();
+                    break;
+                case 9:
+                    makeGroupReservation();
+                    break;
+                case 10:
+                    searchRoutesMenu();
+                    break;
+                case 11:
+                    findConnectionsMenu();
+                    break;
+                case 12:
+                    makeItineraryReservation();
+                    break;
+                case 13:
+                    displayOperationStats();
+                    break;
+                case 14:
+                    displaySqlProfile();
+                    break;
                 case 0:
                     cout << "Exiting the system.\n";
                     break;
@@ -232,8 +1643,26 @@
         return 0;
     }
 
-    void initializeDatabase() {
-        const char* sql = 
+    // Part of a table rebuild: copies the rows of one table, a rowid range per transaction
+    struct Backfill {
+        const char* source;   // Table whose rowids are walked
+        const char* copySQL;  // Copies the source rows with ?1 <= rowid <= ?2
+    };
+
+    // A schema change taking the database from version - 1 to version
+    struct Migration {
+        int version;                 // PRAGMA user_version once it has been applied
+        const char* description;     // Shown while it runs
+        const char* schemaSQL;       // Runs first, in one transaction
+        vector<Backfill> backfills;  // Then these in order, MIGRATION_BATCH_ROWS rowids per transaction
+        const char* finishSQL;       // Runs last, in the transaction that records the version
+        const char* orphansTable;    // Keeps source rows that couldn't be carried over, or null
+    };
+
+    // Every schema the database has had, oldest first. A new index, column or table goes
+    // in a new entry at the end; applied entries must never change.
+    static const vector<Migration> MIGRATIONS = {
+        {1, "Flights and Users tables",
             "CREATE TABLE IF NOT EXISTS Flights ("  // Creates Flights table if it doesn't exist
             "flightNumber TEXT PRIMARY KEY,"        // Unique identifier for flights
             "airlineName TEXT NOT NULL,"            // Airline name (required)
@@ -241,665 +1670,4541 @@
             "destination TEXT NOT NULL,"            // Arrival city (required)
             "totalTickets INTEGER NOT NULL,"        // Total seats available
             "availableTickets INTEGER NOT NULL);"   // Seats remaining
-            
+
             "CREATE TABLE IF NOT EXISTS Users ("    // Creates Users table if it doesn't exist
             "userID TEXT PRIMARY KEY,"             // Unique passenger ID
             "name TEXT NOT NULL,"                  // Passenger name (required)
             "flightNumber TEXT NOT NULL,"          // Associated flight
             "seatNumber INTEGER NOT NULL,"         // Assigned seat
             "UNIQUE(flightNumber, seatNumber),"    // Ensures no duplicate seats per flight
-            "FOREIGN KEY(flightNumber) REFERENCES Flights(flightNumber));";  // Links to Flights table
+            "FOREIGN KEY(flightNumber) REFERENCES Flights(flightNumber));",  // Links to Flights table
+            {}, "", nullptr},
 
-        if (executeSQL(sql)) {
-            cout << "Database initialized successfully\n";
-        }
-    }
+        {2, "route index",
+            "CREATE INDEX IF NOT EXISTS FlightsByRoute "  // Route search by city pair
+            "ON Flights(startingPoint, destination);",
+            {}, "", nullptr},
 
-    bool executeSQL(const string& sql) {
-        sqlite3* db;                     // Database connection object
-        char* errMsg = nullptr;          // For storing error messages
-        bool success = false;            // Return status
+        {3, "Passengers and Bookings with integer keys",
+            "DROP INDEX IF EXISTS FlightsByRoute;"  // Recreated on the new table
+            "ALTER TABLE Flights RENAME TO LegacyFlights;"
+            "ALTER TABLE Users RENAME TO LegacyUsers;"
 
-        if (sqlite3_open(DB_FILE.c_str(), &db) == SQLITE_OK) {  // Open database
-            // Execute SQL command
-            if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
-                /*
-                db: Database connection
+            "CREATE TABLE Flights ("
+            "id INTEGER PRIMARY KEY,"               // Compact key used by bookings
+            "flightNumber TEXT NOT NULL UNIQUE,"    // Unique identifier for flights
+            "airlineName TEXT NOT NULL,"            // Airline name (required)
+            "startingPoint TEXT NOT NULL,"          // Departure city (required)
+            "destination TEXT NOT NULL,"            // Arrival city (required)
+            "totalTickets INTEGER NOT NULL,"        // Total seats available
+            "availableTickets INTEGER NOT NULL);"   // Seats remaining
 
-                sql.c_str(): The SQL command to execute (converted to C-style string)
+            "CREATE TABLE Passengers ("             // One row per person
+            "id INTEGER PRIMARY KEY,"               // Compact key used by bookings
+            "userID TEXT NOT NULL UNIQUE,"          // Unique passenger ID
+            "name TEXT NOT NULL);"                  // Passenger name (required)
 
-                nullptr: No callback function (since we're not processing row results)
+            "CREATE TABLE Bookings ("               // One row per seat sold
+            "flightID INTEGER NOT NULL REFERENCES Flights(id),"
+            "seatNumber INTEGER NOT NULL,"
+            "passengerID INTEGER NOT NULL REFERENCES Passengers(id),"
+            "PRIMARY KEY(flightID, seatNumber)"     // Ensures no duplicate seats per flight
+            ") WITHOUT ROWID;"
 
-                nullptr: No data to pass to callback
+            "CREATE UNIQUE INDEX BookingsByPassenger "  // A passenger's bookings,
+            "ON Bookings(passengerID, flightID);"       // at most one per flight
 
-                &errMsg: Address to store any error message
-                
-                */
-                cerr << "SQL error: " << errMsg << endl;  // Print error if any
-                sqlite3_free(errMsg);     // Free error message memory
-            } else {
-                success = true;           // Mark as successful
-            }
-            sqlite3_close(db);           // Close database connection
-        } else {
-            cerr << "Can't open database: " << sqlite3_errmsg(db) << endl;
+            "CREATE TABLE LegacyOrphans ("          // Old bookings whose flight no longer exists
+            "userID TEXT NOT NULL,"
+            "name TEXT NOT NULL,"
+            "flightNumber TEXT NOT NULL,"
+            "seatNumber INTEGER NOT NULL);",
+            {
+                {"LegacyFlights",  // Flight rowids become the new ids
+                    "INSERT INTO Flights (id, flightNumber, airlineName, startingPoint, destination, "
+                    "totalTickets, availableTickets) "
+                    "SELECT rowid, flightNumber, airlineName, startingPoint, destination, totalTickets, "
+                    "availableTickets FROM LegacyFlights WHERE rowid BETWEEN ?1 AND ?2;"},
+                {"LegacyUsers",
+                    "INSERT INTO Passengers (userID, name) "
+                    "SELECT userID, name FROM LegacyUsers WHERE rowid BETWEEN ?1 AND ?2 ORDER BY rowid;"},
+                {"LegacyUsers",
+                    "INSERT INTO Bookings (flightID, seatNumber, passengerID) "
+                    "SELECT f.id, u.seatNumber, p.id FROM LegacyUsers u "
+                    "JOIN Flights f ON f.flightNumber = u.flightNumber JOIN Passengers p ON p.userID = u.userID "
+                    "WHERE u.rowid BETWEEN ?1 AND ?2;"},
+                {"LegacyUsers",  // Whatever the copy above couldn't carry over, kept rather than dropped
+                    "INSERT INTO LegacyOrphans (userID, name, flightNumber, seatNumber) "
+                    "SELECT u.userID, u.name, u.flightNumber, u.seatNumber FROM LegacyUsers u "
+                    "WHERE u.rowid BETWEEN ?1 AND ?2 AND NOT EXISTS (SELECT 1 FROM Bookings b "
+                    "JOIN Passengers p ON p.id = b.passengerID WHERE p.userID = u.userID);"},
+            },
+            "DROP TABLE LegacyUsers;"
+            "DROP TABLE LegacyFlights;"
+
+            "CREATE INDEX FlightsByRoute "          // Route search by city pair
+            "ON Flights(startingPoint, destination);"
+
+            "CREATE VIEW Users AS "                 // The original one-row-per-booking shape
+            "SELECT p.userID AS userID, p.name AS name, f.flightNumber AS flightNumber, b.seatNumber AS seatNumber "
+            "FROM Bookings b JOIN Passengers p ON p.id = b.passengerID JOIN Flights f ON f.id = b.flightID;",
+            "LegacyOrphans"},
+    };
+
+    // Runs a query that returns one integer
+    // @return: The value, or fallback if there is no row or the query fails
+    static sqlite3_int64 queryInt(const string& sql, sqlite3_int64 fallback) {
+        StatementHandle stmt(sql);
+        if (!stmt || sqlite3_step(stmt.get()) != SQLITE_ROW || sqlite3_column_type(stmt.get(), 0) == SQLITE_NULL) {
+            return fallback;
         }
-        return success;
+        return sqlite3_column_int64(stmt.get(), 0);
     }
 
-// Function to execute SQL query with a callback function
-bool executeSQLWithCallback(const string& sql, int (*callback)(void*, int, char**, char**), void* data) {
-    sqlite3* db;  // Database handle
-    char* errMsg = nullptr;  // Error message pointer
-    bool success = false;  // Success flag
+    static bool schemaObjectExists(const char* type, const char* name) {
+        StatementHandle stmt("SELECT 1 FROM sqlite_master WHERE type = ? AND name = ?;");
+        if (!stmt) return false;
+        sqlite3_bind_text(stmt.get(), 1, type, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 2, name, -1, SQLITE_STATIC);
+        return sqlite3_step(stmt.get()) == SQLITE_ROW;
+    }
 
-    // Open database connection
-    if (sqlite3_open(DB_FILE.c_str(), &db) == SQLITE_OK) {
-        // Execute SQL query with callback
-        if (sqlite3_exec(db, sql.c_str(), callback, data, &errMsg) != SQLITE_OK) {
-            cerr << "SQL error: " << errMsg << endl;  // Print error if query fails
-            sqlite3_free(errMsg);  // Free error message memory
-        } else {
-            success = true;  // Set success flag if query succeeds
+    // Reads the schema version, working it out from the tables of a database made before
+    // versions were recorded (user_version 0) and recording it
+    // @return: Schema version, 0 for an empty database, or -1 on error
+    static int schemaVersion() {
+        int version = static_cast<int>(queryInt("PRAGMA user_version;", -1));
+        if (version != 0) return version;
+
+        if (schemaObjectExists("table", "Passengers")) {
+            version = 3;
+        } else if (schemaObjectExists("table", "Users")) {
+            version = schemaObjectExists("index", "FlightsByRoute") ? 2 : 1;
         }
-        sqlite3_close(db);  // Close database connection
-    } else {
-        cerr << "Can't open database: " << sqlite3_errmsg(db) << endl;  // Print error if can't open database
+        if (version > 0 && !executeSQL("PRAGMA user_version = " + to_string(version) + ";")) return -1;
+        return version;
     }
 
-    return success;  // Return success status
-}
+    // Copies a backfill's rows a batch at a time, each batch in its own transaction together
+    // with its progress in MigrationProgress, so that an interrupted copy resumes where it stopped
+    // @param step: Position of the backfill in its migration
+    // @return: true once every row has been copied
+    static bool runBackfill(int step, const Backfill& backfill) {
+        const string lastSQL = "SELECT lastRowid FROM MigrationProgress WHERE step = " + to_string(step) + ";";
+        const string endSQL = string("SELECT max(rowid) FROM ") + backfill.source + ";";
+        while (true) {
+            Transaction txn;
+            if (!txn.active()) return false;
+            if (!schemaObjectExists("table", "MigrationProgress")) return true;  // Finished by another process
 
-// Check if a flight exists in the database
-bool flightExists(const string& flightNumber) {
-    sqlite3* db;  // Database handle
-    sqlite3_stmt* stmt;  // Prepared statement object
-    bool exists = false;  // Existence flag
+            sqlite3_int64 last = queryInt(lastSQL, 0);
+            sqlite3_int64 end = queryInt(endSQL, 0);
+            if (last >= end) return true;
+            sqlite3_int64 upTo = min(end, last + MIGRATION_BATCH_ROWS);
+            {
+                StatementHandle stmt(backfill.copySQL);
+                if (!stmt) return false;
+                sqlite3_bind_int64(stmt.get(), 1, last + 1);
+                sqlite3_bind_int64(stmt.get(), 2, upTo);
+                if (sqlite3_step(stmt.get()) != SQLITE_DONE) return false;
+            }
+            {
+                StatementHandle stmt("INSERT OR REPLACE INTO MigrationProgress (step, lastRowid) VALUES (?, ?);");
+                if (!stmt) return false;
+                sqlite3_bind_int(stmt.get(), 1, step);
+                sqlite3_bind_int64(stmt.get(), 2, upTo);
+                if (sqlite3_step(stmt.get()) != SQLITE_DONE) return false;
+            }
+            if (!txn.commit()) return false;
+        }
+    }
 
-    // Open database connection
-    if (sqlite3_open(DB_FILE.c_str(), &db) == SQLITE_OK) {
-        const char* sql = "SELECT 1 FROM Flights WHERE flightNumber = ?;";  // SQL query
-        // Prepare SQL statement
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-        /*
-        ? is a placeholder for the flight number
+    // Applies one migration, or finishes it if an earlier run was interrupted. Each stage
+    // checks the version inside its own transaction, so two processes starting together
+    // don't apply it twice.
+    // @return: true once the database is at migration.version
+    static bool applyMigration(const Migration& migration) {
+        {
+            Transaction txn;
+            if (!txn.active()) return false;
+            if (schemaVersion() >= migration.version) return true;
+            if (!schemaObjectExists("table", "MigrationProgress")) {  // Not started yet
+                if (!executeSQL(migration.schemaSQL)) return false;
+                if (!migration.backfills.empty() &&
+                    !executeSQL("CREATE TABLE MigrationProgress (step INTEGER PRIMARY KEY, lastRowid INTEGER NOT NULL);")) {
+                    return false;
+                }
+            }
+            if (!txn.commit()) return false;
+        }
+
+        for (size_t step = 0; step < migration.backfills.size(); step++) {
+            if (!runBackfill(static_cast<int>(step), migration.backfills[step])) return false;
+        }
 
-        sqlite3_prepare_v2 compiles the SQL statement
+        Transaction txn;
+        if (!txn.active()) return false;
+        if (schemaVersion() >= migration.version) return true;
+        return executeSQL(migration.finishSQL) &&
+               executeSQL("DROP TABLE IF EXISTS MigrationProgress;"
+                          "PRAGMA user_version = " + to_string(migration.version) + ";") &&
+               txn.commit();
+    }
 
-        -1 means automatic SQL string length detection
+    // Brings the database up to the last entry of MIGRATIONS
+    // @param announce: Report migrations of an existing database as they run
+    // @return: true if the database is at the current version
+    static bool migrateSchema(bool announce) {
+        int version = schemaVersion();
+        if (version < 0) return false;
+        if (version > MIGRATIONS.back().version) {
+            cerr << "Database schema version " << version << " is newer than this program supports" << endl;
+            return false;
+        }
 
-        stmt stores the prepared statement
-        */
-            sqlite3_bind_text(stmt, 1, flightNumber.c_str(), -1, SQLITE_STATIC);  // Bind parameter
-            if (sqlite3_step(stmt) == SQLITE_ROW) {  // Execute query
-                exists = true;  // Set flag if flight exists
+        for (const Migration& migration : MIGRATIONS) {
+            if (migration.version <= version) continue;
+            if (announce && version > 0) {
+                cout << "Updating database to version " << migration.version << " (" << migration.description << ")\n";
+            }
+            if (!applyMigration(migration)) {
+                cerr << "Couldn't update the database to version " << migration.version << endl;
+                return false;
+            }
+            if (migration.orphansTable && schemaObjectExists("table", migration.orphansTable)) {
+                sqlite3_int64 orphans = queryInt(string("SELECT count(*) FROM ") + migration.orphansTable + ";", -1);
+                if (orphans == 0) {
+                    executeSQL(string("DROP TABLE IF EXISTS ") + migration.orphansTable + ";");  // Nothing was left over
+                } else {
+                    cerr << "Version " << migration.version << ": " << orphans << " row(s) couldn't be carried over "
+                         << "and were kept in " << migration.orphansTable << endl;
+                }
             }
-            sqlite3_finalize(stmt);  // Finalize statement
         }
-        sqlite3_close(db);  // Close database connection
+        return true;
     }
 
-    return exists;  // Return existence status
-}
+    void initializeDatabase(bool announce) {
+        if (migrateSchema(announce) && FlightCatalog::instance().load()) {
+            CheckpointManager::instance();  // Start managing the write-ahead log
+            if (announce) cout << "Database initialized successfully\n";
+        }
+    }
 
-// Check if a user exists in the database
-bool userExists(const string& userID) {
-    sqlite3* db;  // Database handle
-    sqlite3_stmt* stmt;  // Prepared statement
-    bool exists = false;  // Existence flag
+    // Binds a pooled connection to a thread and hands it back when the thread exits
+    struct ThreadConnection {
+        Connection* conn = nullptr;  // Connection bound to this thread, if any
 
-    // Open database connection
-    if (sqlite3_open(DB_FILE.c_str(), &db) == SQLITE_OK) {
-        const char* sql = "SELECT 1 FROM Users WHERE userID = ?;";  // SQL query
-        // Prepare SQL statement
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, userID.c_str(), -1, SQLITE_STATIC);  // Bind parameter
-            if (sqlite3_step(stmt) == SQLITE_ROW) {  // Execute query
-                exists = true;  // Set flag if user exists
-            }
-            sqlite3_finalize(stmt);  // Finalize statement
+        ~ThreadConnection() {
+            if (conn) ConnectionPool::instance().release(conn);  // Return it to the pool
         }
-        sqlite3_close(db);  // Close database connection
+    };
+
+    thread_local ThreadConnection threadConnection;  // The calling thread's binding
+
+    ConnectionPool& ConnectionPool::instance() {
+        static ConnectionPool pool;  // Constructed on first use, closed at exit
+        return pool;
     }
 
-    return exists;  // Return existence status
-}
+    void ConnectionPool::configure(const string& newPath, size_t newMaxConnections) {
+        lock_guard<mutex> lock(mtx);
+        path = newPath;
+        maxConnections = newMaxConnections > 0 ? newMaxConnections : 1;
+    }
 
-// Check if a seat is available on a flight
-bool isSeatAvailable(const string& flightNumber, int seatNumber) {
-    sqlite3* db;  // Database handle
-    sqlite3_stmt* stmt;  // Prepared statement
-    bool available = true;  // Availability flag
+    Connection* ConnectionPool::acquire() {
+        if (threadConnection.conn) return threadConnection.conn;  // Already bound
 
-    // Open database connection
-    if (sqlite3_open(DB_FILE.c_str(), &db) == SQLITE_OK) {
-        const char* sql = "SELECT 1 FROM Users WHERE flightNumber = ? AND seatNumber = ?;";  // SQL query
-        // Prepare SQL statement
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, flightNumber.c_str(), -1, SQLITE_STATIC);  // Bind first parameter
-            sqlite3_bind_int(stmt, 2, seatNumber);  // Bind second parameter
-            if (sqlite3_step(stmt) == SQLITE_ROW) {  // Execute query
-                available = false;  // Set flag if seat is taken
-            }
-            sqlite3_finalize(stmt);  // Finalize statement
+        unique_lock<mutex> lock(mtx);
+        // Wait until a connection is idle or another one may still be opened
+        connectionFreed.wait(lock, [this] {
+            return !idle.empty() || connections.size() < maxConnections;
+        });
+
+        Connection* conn = nullptr;
+        if (!idle.empty()) {
+            conn = idle.back();  // Reuse an already open connection
+            idle.pop_back();
+        } else {
+            conn = open();
+            if (!conn) return nullptr;
         }
-        sqlite3_close(db);  // Close database connection
+        threadConnection.conn = conn;
+        return conn;
     }
 
-    return available;  // Return availability status
-}
+    void ConnectionPool::release(Connection* conn) {
+        {
+            lock_guard<mutex> lock(mtx);
+            idle.push_back(conn);
+        }
+        connectionFreed.notify_one();  // Wake one waiting thread
+    }
 
-// Get list of taken seats for a flight
-vector<int> getTakenSeats(const string& flightNumber) {
-    sqlite3* db;  // Database handle
-    sqlite3_stmt* stmt;  // Prepared statement
-    vector<int> takenSeats;  // Vector to store taken seats
+    // Makes a connection wait out other connections' locks for up to BUSY_TIMEOUT_MS;
+    // when tracing, the same wait is done by a handler that records it
+    static void waitForLocks(sqlite3* db) {
+        if (TraceRecorder::active()) sqlite3_busy_handler(db, TraceRecorder::busyWait, nullptr);
+        else sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+    }
 
-    // Open database connection
-    if (sqlite3_open(DB_FILE.c_str(), &db) == SQLITE_OK) {
-        const char* sql = "SELECT seatNumber FROM Users WHERE flightNumber = ?;";  // SQL query
-        // Prepare SQL statement
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, flightNumber.c_str(), -1, SQLITE_STATIC);  // Bind parameter
-            while (sqlite3_step(stmt) == SQLITE_ROW) {  // Execute query and process results
-                takenSeats.push_back(sqlite3_column_int(stmt, 0));  // Add seat number to vector
-            }
-            sqlite3_finalize(stmt);  // Finalize statement
+    Connection* ConnectionPool::open() {
+        TraceSpan span("open", path);
+        sqlite3* db = nullptr;
+        if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+            cerr << "Can't open database: " << sqlite3_errmsg(db) << endl;
+            sqlite3_close(db);  // A handle is allocated even when opening fails
+            return nullptr;
         }
-        sqlite3_close(db);  // Close database connection
-    }
+        waitForLocks(db);
 
-    return takenSeats;  // Return vector of taken seats
-}
+        // Journal, durability and cache settings, all taken from storageConfig
+        string pragmas =
+            "PRAGMA journal_mode = " + string(storageConfig.journalMode) + ";"
+            "PRAGMA synchronous = " + string(storageConfig.synchronous) + ";"
+            "PRAGMA cache_size = -" + to_string(storageConfig.cacheSizeKiB) + ";"
+            "PRAGMA mmap_size = " + to_string(storageConfig.mmapSizeBytes) + ";";
+        char* errMsg = nullptr;
+        if (sqlite3_exec(db, pragmas.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            cerr << "SQL error: " << errMsg << endl;
+            sqlite3_free(errMsg);
+        }
+        // Report commits to the checkpoint manager; this also turns off SQLite's
+        // built-in auto-checkpoint, which would run on the committing thread
+        sqlite3_wal_hook(db, [](void*, sqlite3*, const char*, int frames) {
+            CheckpointManager::instance().noteCommit(frames);
+            return SQLITE_OK;
+        }, nullptr);
 
-// Callback function to process flight data from SQL query results
-// Parameters:
-//   data - User-provided pointer (unused in this function)
-//   argc - Number of columns in the result row
-//   argv - Array of column values for the current row
-//   azColName - Array of column names
-int flightCallback(void* data, int argc, char** argv, char** azColName) {
-    // Create a temporary Flight object to store the current row's data
-    Flight flight;  // Flight object to store data
-    
-    // Loop through each column in the current result row
-    for (int i = 0; i < argc; i++) {
-        // Get the name of the current column
-        string colName = azColName[i];  // Get column name
-        
-        // Check column name and store the corresponding value in the Flight object
-        if (colName == "flightNumber") 
-            // Store flight number (use empty string if NULL)
-            flight.flightNumber = argv[i] ? argv[i] : "";
-        else if (colName == "airlineName") 
-            // Store airline name (use empty string if NULL)
-            flight.airlineName = argv[i] ? argv[i] : "";
-        else if (colName == "startingPoint") 
-            // Store starting point (use empty string if NULL)
-            flight.startingPoint = argv[i] ? argv[i] : "";
-        else if (colName == "destination") 
-            // Store destination (use empty string if NULL)
-            flight.destination = argv[i] ? argv[i] : "";
-        else if (colName == "totalTickets") 
-            // Convert totalTickets from string to integer (default to 0 if NULL)
-            flight.totalTickets = argv[i] ? atoi(argv[i]) : 0;
-        else if (colName == "availableTickets") 
-            // Convert availableTickets from string to integer (default to 0 if NULL)
-            flight.availableTickets = argv[i] ? atoi(argv[i]) : 0;
+        connections.push_back(make_unique<Connection>());
+        Connection* conn = connections.back().get();
+        conn->db = db;
+
+        // Count statements and result rows and time each execution for the operation metrics,
+        // and aggregate them per statement when profiling
+        sqlite3_trace_v2(db, SQLITE_TRACE_STMT | SQLITE_TRACE_ROW | SQLITE_TRACE_PROFILE, SqlProfiler::trace, nullptr);
+
+        // Remember which Flights rows each transaction touches, for the flight catalog
+        sqlite3_update_hook(db, [](void* owner, int, const char*, const char* table, sqlite3_int64 rowid) {
+            if (strcmp(table, "Flights") == 0) {
+                static_cast<Connection*>(owner)->changedFlights.push_back(rowid);
+            }
+        }, conn);
+        return conn;
     }
-    
-    // Display the flight information using the Flight object's display method
-    flight.display();  // Display flight information
-    
-    // Print a separator line for better readability between flight records
-    cout << "----------------------------------------\n";  // Separator
-    
-    // Return 0 to indicate successful processing and continue to next row
-    return 0;  // Return success
-}
 
-// Callback function for user data
-int userCallback(void* data, int argc, char** argv, char** azColName) {
-    User user;  // User object to store data
-    // Process each column in the result row
-    for (int i = 0; i < argc; i++) {
-        string colName = azColName[i];  // Get column name
-        // Map column to user property
-        if (colName == "name") user.name = argv[i] ? argv[i] : "";
-        else if (colName == "userID") user.userID = argv[i] ? argv[i] : "";
-        else if (colName == "flightNumber") user.flightNumber = argv[i] ? argv[i] : "";
-        else if (colName == "seatNumber") user.seatNumber = argv[i] ? atoi(argv[i]) : 0;
+    StatementCacheStats ConnectionPool::statementStats() {
+        lock_guard<mutex> lock(mtx);
+        StatementCacheStats totals;
+        for (auto& conn : connections) {
+            conn->statements.addStats(totals);
+        }
+        return totals;
     }
-    user.display();  // Display user information
-    cout << "----------------------------------------\n";  // Separator
-    return 0;  // Return success
-}
 
-// Add a new flight to the database
-void addFlight() {
-    Flight flight;  // Flight object to store new data
-    cout << "\nEnter Flight Number: ";
-    getline(cin, flight.flightNumber);  // Get flight number from user
-    
-    // Check if flight already exists
-    if (flightExists(flight.flightNumber)) {
-        cout << "Flight with this number already exists!\n";
-        return;
+    ConnectionPool::~ConnectionPool() {
+        for (auto& conn : connections) {
+            conn->statements.clear();    // Statements must be finalized before closing
+            sqlite3_close_v2(conn->db);  // Close every connection opened by the pool
+        }
     }
 
-    // Get remaining flight details from user
-    cout << "Enter Airline Name: ";
-    getline(cin, flight.airlineName);
-    cout << "Enter Starting Point: ";
-    getline(cin, flight.startingPoint);
-    cout << "Enter Destination: ";
-    getline(cin, flight.destination);
-    cout << "Enter Total Tickets: ";
-    cin >> flight.totalTickets;
-    flight.availableTickets = flight.totalTickets;  // Set available tickets equal to total
-    cin.ignore();  // Clear input buffer
+    sqlite3_stmt* StatementCache::acquire(sqlite3* db, const string& sql, bool& cached) {
+        auto found = index.find(sql);
+        if (found != index.end() && !found->second->inUse) {
+            hits++;
+            entries.splice(entries.begin(), entries, found->second);  // Mark most recently used
+            found->second->inUse = true;
+            cached = true;
+            return found->second->stmt;
+        }
 
-    // Build SQL insert statement
-    string sql = "INSERT INTO Flights VALUES ('" + flight.flightNumber + "', '" +
-                flight.airlineName + "', '" + flight.startingPoint + "', '" +
-                flight.destination + "', " + to_string(flight.totalTickets) + ", " +
-                to_string(flight.availableTickets) + ");";
+        misses++;
+        TraceSpan span("prepare", sql);
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            cerr << "SQL error: " << sqlite3_errmsg(db) << endl;
+            return nullptr;
+        }
+        if (found != index.end()) {
+            cached = false;  // Same query already borrowed (nested use) - run it uncached
+            return stmt;
+        }
 
-    // Execute SQL and show result
-    if (executeSQL(sql)) {
-        cout << "Flight added successfully.\n";
+        entries.push_front(Entry{sql, stmt, true});
+        index[sql] = entries.begin();
+        byStmt[stmt] = entries.begin();
+        evict();
+        cached = true;
+        return stmt;
     }
-}
 
-// Modify an existing flight
-void modifyFlight() {
-    string flightNumber;  // Flight number to modify
-    cout << "\nEnter Flight Number to modify: ";
-    getline(cin, flightNumber);
+    void StatementCache::release(sqlite3_stmt* stmt) {
+        sqlite3_reset(stmt);           // Ends the statement's read transaction
+        sqlite3_clear_bindings(stmt);  // Never leak values into the next use
+        auto found = byStmt.find(stmt);
+        if (found != byStmt.end()) {
+            found->second->inUse = false;
+        }
+        evict();
+    }
 
-    // Check if flight exists
-    if (!flightExists(flightNumber)) {
-        cout << "Flight not found!\n";
-        return;
+    void StatementCache::evict() {
+        // Walk from the least recently used end, skipping statements still borrowed
+        auto it = entries.end();
+        while (entries.size() > capacity && it != entries.begin()) {
+            --it;
+            if (it->inUse) continue;
+            sqlite3_finalize(it->stmt);
+            index.erase(it->sql);
+            byStmt.erase(it->stmt);
+            it = entries.erase(it);
+            evictions++;
+        }
     }
 
-    Flight flight;  // Flight object for new data
-    flight.flightNumber = flightNumber;
-    // Get new flight details from user
-    cout << "Enter New Airline Name: ";
-    getline(cin, flight.airlineName);
-    cout << "Enter New Starting Point: ";
-    getline(cin, flight.startingPoint);
-    cout << "Enter New Destination: ";
-    getline(cin, flight.destination);
-    cout << "Enter New Total Tickets: ";
-    cin >> flight.totalTickets;
-    cout << "Enter New Available Tickets: ";
-    cin >> flight.availableTickets;
-    cin.ignore(); // Clear input buffer
+    void StatementCache::clear() {
+        for (auto& entry : entries) {
+            sqlite3_finalize(entry.stmt);
+        }
+        entries.clear();
+        index.clear();
+        byStmt.clear();
+    }
 
-    // Build SQL update statement
-    string sql = "UPDATE Flights SET "
-        "airlineName = '" + flight.airlineName + "', "
-        "startingPoint = '" + flight.startingPoint + "', "
-        "destination = '" + flight.destination + "', "
-        "totalTickets = " + to_string(flight.totalTickets) + ", "
-        "availableTickets = " + to_string(flight.availableTickets) + " "
-        "WHERE flightNumber = '" + flightNumber + "';";
-    
-    // Execute SQL and show result
-    if (executeSQL(sql)) {
-        cout << "Flight modified successfully.\n";
+    void StatementCache::addStats(StatementCacheStats& totals) const {
+        totals.hits += hits.load(memory_order_relaxed);
+        totals.misses += misses.load(memory_order_relaxed);
+        totals.evictions += evictions.load(memory_order_relaxed);
     }
-}
 
-// Delete a flight from the database
-void deleteFlight() {
-    string flightNumber;  // Flight number to delete
-    cout << "\nEnter Flight Number to delete: ";
-    getline(cin, flightNumber);
+    int LatencyHistogram::bucketOf(uint64_t nanos) {
+        if (nanos < static_cast<uint64_t>(HISTOGRAM_SUB_BUCKETS)) return static_cast<int>(nanos);
+        int exponent = 63 - __builtin_clzll(nanos);
+        if (exponent > HISTOGRAM_MAX_EXPONENT) return HISTOGRAM_BUCKETS - 1;
+        int sub = static_cast<int>(nanos >> (exponent - HISTOGRAM_SUB_BUCKET_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1);
+        return (exponent - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+    }
 
-    // Check if flight exists
-    if (!flightExists(flightNumber)) {
-        cout << "Flight not found!\n";
-        return;
+    uint64_t LatencyHistogram::bucketValue(int bucket) {
+        if (bucket < HISTOGRAM_SUB_BUCKETS) return bucket;
+        int exponent = bucket / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKET_BITS - 1;
+        uint64_t width = uint64_t(1) << (exponent - HISTOGRAM_SUB_BUCKET_BITS);
+        uint64_t lowest = uint64_t(HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) * width;
+        return lowest + width / 2;
     }
 
-    // First delete all users associated with this flight
-    string deleteUsersSql = "DELETE FROM Users WHERE flightNumber = '" + flightNumber + "';";
-    string deleteFlightSql = "DELETE FROM Flights WHERE flightNumber = '" + flightNumber + "';";
-    
-    // Execute both deletions and show result
-    if (executeSQL(deleteUsersSql) && executeSQL(deleteFlightSql)) {
-        cout << "Flight and associated users deleted successfully.\n";
+    void LatencyHistogram::record(uint64_t nanos, uint64_t statementCount, uint64_t rowCount) {
+        bump(buckets[bucketOf(nanos)]);
+        bump(count);
+        bump(totalNanos, nanos);
+        if (nanos > maxNanos.load(memory_order_relaxed)) maxNanos.store(nanos, memory_order_relaxed);
+        bump(statements, statementCount);
+        bump(rows, rowCount);
     }
-}
 
-// Add a new user to the database
-void addUser() {
-    User user;  // User object for new data
-    cout << "\nEnter User ID: ";
-    getline(cin, user.userID);
-    
-    // Check if user already exists
-    if (userExists(user.userID)) {
-        cout << "User with this ID already exists!\n";
-        return;
+    void LatencyHistogram::mergeInto(HistogramSnapshot& total) const {
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) total.buckets[i] += buckets[i].load(memory_order_relaxed);
+        total.count += count.load(memory_order_relaxed);
+        total.totalNanos += totalNanos.load(memory_order_relaxed);
+        total.maxNanos = max(total.maxNanos, maxNanos.load(memory_order_relaxed));
+        total.statements += statements.load(memory_order_relaxed);
+        total.rows += rows.load(memory_order_relaxed);
     }
 
-    // Get user details from input
-    cout << "Enter Name: ";
-    getline(cin, user.name);
-    cout << "Enter Flight Number: ";
-    getline(cin, user.flightNumber);
-    
-    // Check if flight exists
-    if (!flightExists(user.flightNumber)) {
-        cout << "Flight doesn't exist!\n";
-        return;
+    uint64_t HistogramSnapshot::percentile(double fraction) const {
+        // Buckets are read one by one while owners keep recording, so count may lag them
+        uint64_t seen = 0, total = 0;
+        for (uint64_t n : buckets) total += n;
+        uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(ceil(fraction * total)));
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank) return min(LatencyHistogram::bucketValue(i), maxNanos);
+        }
+        return maxNanos;
     }
 
-    // Get and display taken seats
-    vector<int> takenSeats = getTakenSeats(user.flightNumber);
-    cout << "Taken seats: ";
-    for (int seat : takenSeats) {
-        cout << seat << " ";
+    LatencyHistogram& ThreadMetrics::histogram(Metric metric) {
+        atomic<LatencyHistogram*>& slot = histograms[static_cast<int>(metric)];
+        LatencyHistogram* histogram = slot.load(memory_order_relaxed);
+        if (!histogram) {
+            histogram = new LatencyHistogram();
+            slot.store(histogram, memory_order_release);  // Readers see a fully built histogram
+        }
+        return *histogram;
     }
-    cout << "\nEnter Seat Number: ";
-    cin >> user.seatNumber;
-    cin.ignore(); // Clear input buffer
 
-    // Check if seat is available
-    if (!isSeatAvailable(user.flightNumber, user.seatNumber)) {
-        cout << "Seat " << user.seatNumber << " is already taken on this flight!\n";
-        return;
+    ThreadMetrics::~ThreadMetrics() {
+        for (auto& histogram : histograms) delete histogram.load();
     }
 
-    // Build SQL insert statement
-    string sql = "INSERT INTO Users VALUES ('" + user.userID + "', '" 
-        + user.name + "', '" + user.flightNumber + "', " 
-        + to_string(user.seatNumber) + ");";
-    
-    // Execute SQL and update available tickets
-    if (executeSQL(sql)) {
-        string updateSql = "UPDATE Flights SET availableTickets = availableTickets - 1 "
-            "WHERE flightNumber = '" + user.flightNumber + "';";
-        executeSQL(updateSql);
-        cout << "User added successfully.\n";
+    MetricsRegistry& MetricsRegistry::instance() {
+        static MetricsRegistry registry;
+        return registry;
     }
-}
 
-// Modify an existing user
-void modifyUser() {
-    string userID;  // User ID to modify
-    cout << "\nEnter User ID to modify: ";
+    ThreadMetrics& MetricsRegistry::local() {
+        thread_local ThreadMetrics* mine = nullptr;
+        if (!mine) {
+            lock_guard<mutex> lock(mtx);
+            threads.push_back(make_unique<ThreadMetrics>());
+            mine = threads.back().get();
+        }
+        return *mine;
+    }
+
+    void MetricsRegistry::snapshot(vector<HistogramSnapshot>& perMetric, uint64_t& statements, uint64_t& rows) {
+        perMetric.assign(static_cast<int>(Metric::Count), HistogramSnapshot());
+        statements = rows = 0;
+        lock_guard<mutex> lock(mtx);
+        for (const auto& thread : threads) {
+            for (int i = 0; i < static_cast<int>(Metric::Count); i++) {
+                LatencyHistogram* histogram = thread->histograms[i].load(memory_order_acquire);
+                if (histogram) histogram->mergeInto(perMetric[i]);
+            }
+            statements += thread->statements.load(memory_order_relaxed);
+            rows += thread->rows.load(memory_order_relaxed);
+        }
+    }
+
+    OperationTimer::OperationTimer(Metric metric)
+        : span(METRIC_NAMES[static_cast<int>(metric)]), metric(metric), metrics(MetricsRegistry::instance().local()),
+          statements(metrics.statements.load(memory_order_relaxed)), rows(metrics.rows.load(memory_order_relaxed)),
+          started(chrono::steady_clock::now()) {}
+
+    OperationTimer::~OperationTimer() {
+        uint64_t nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count();
+        metrics.histogram(metric).record(nanos, metrics.statements.load(memory_order_relaxed) - statements,
+                                         metrics.rows.load(memory_order_relaxed) - rows);
+    }
+
+    atomic<bool> TraceRecorder::enabled{false};
+
+    TraceRecorder& TraceRecorder::instance() {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+
+    // VFS shim installed while tracing: wraps the default VFS's files and records each xSync
+    // (fsync of the database, WAL or journal) as a span; everything else is passed through
+    static sqlite3_vfs* tracedBaseVfs = nullptr;       // The default VFS before tracing
+    static sqlite3_vfs tracedVfs;                      // Copy of it with xOpen wrapped
+    static sqlite3_io_methods tracedIoMethods[3];      // Wrappers for io_methods versions 1 to 3
+
+    struct TracedFile {
+        sqlite3_file base;   // What SQLite sees; must come first
+        sqlite3_file* real;  // The default VFS's file, allocated right after this struct
+        const char* name;    // Base name of the file, shown with its fsync spans
+    };
+
+    static sqlite3_file* realFile(sqlite3_file* file) { return reinterpret_cast<TracedFile*>(file)->real; }
+
+    static int tracedOpen(sqlite3_vfs*, const char* name, sqlite3_file* file, int flags, int* outFlags) {
+        TracedFile* traced = reinterpret_cast<TracedFile*>(file);
+        traced->real = reinterpret_cast<sqlite3_file*>(traced + 1);
+        const char* slash = name ? strrchr(name, '/') : nullptr;
+        traced->name = !name ? "temporary file" : slash ? slash + 1 : name;
+        int rc = tracedBaseVfs->xOpen(tracedBaseVfs, name, traced->real, flags, outFlags);
+        // SQLite calls xClose whenever pMethods is set, even if opening failed
+        const sqlite3_io_methods* methods = traced->real->pMethods;
+        traced->base.pMethods = methods ? &tracedIoMethods[min(methods->iVersion, 3) - 1] : nullptr;
+        return rc;
+    }
+
+    static void installTracedVfs() {
+        tracedBaseVfs = sqlite3_vfs_find(nullptr);
+        tracedVfs = *tracedBaseVfs;  // pAppData and the other methods stay the default VFS's own
+        tracedVfs.zName = "trace";
+        tracedVfs.szOsFile = sizeof(TracedFile) + tracedBaseVfs->szOsFile;
+        tracedVfs.xOpen = tracedOpen;
+
+        sqlite3_io_methods methods = {};
+        methods.xClose = [](sqlite3_file* f) { return realFile(f)->pMethods->xClose(realFile(f)); };
+        methods.xRead = [](sqlite3_file* f, void* data, int amount, sqlite3_int64 offset) {
+            return realFile(f)->pMethods->xRead(realFile(f), data, amount, offset);
+        };
+        methods.xWrite = [](sqlite3_file* f, const void* data, int amount, sqlite3_int64 offset) {
+            return realFile(f)->pMethods->xWrite(realFile(f), data, amount, offset);
+        };
+        methods.xTruncate = [](sqlite3_file* f, sqlite3_int64 size) { return realFile(f)->pMethods->xTruncate(realFile(f), size); };
+        methods.xSync = [](sqlite3_file* f, int flags) {
+            TraceSpan span("fsync", reinterpret_cast<TracedFile*>(f)->name);
+            return realFile(f)->pMethods->xSync(realFile(f), flags);
+        };
+        methods.xFileSize = [](sqlite3_file* f, sqlite3_int64* size) { return realFile(f)->pMethods->xFileSize(realFile(f), size); };
+        methods.xLock = [](sqlite3_file* f, int lock) { return realFile(f)->pMethods->xLock(realFile(f), lock); };
+        methods.xUnlock = [](sqlite3_file* f, int lock) { return realFile(f)->pMethods->xUnlock(realFile(f), lock); };
+        methods.xCheckReservedLock = [](sqlite3_file* f, int* out) {
+            return realFile(f)->pMethods->xCheckReservedLock(realFile(f), out);
+        };
+        methods.xFileControl = [](sqlite3_file* f, int op, void* arg) {
+            return realFile(f)->pMethods->xFileControl(realFile(f), op, arg);
+        };
+        methods.xSectorSize = [](sqlite3_file* f) { return realFile(f)->pMethods->xSectorSize(realFile(f)); };
+        methods.xDeviceCharacteristics = [](sqlite3_file* f) {
+            return realFile(f)->pMethods->xDeviceCharacteristics(realFile(f));
+        };
+        methods.xShmMap = [](sqlite3_file* f, int region, int size, int extend, void volatile** out) {
+            return realFile(f)->pMethods->xShmMap(realFile(f), region, size, extend, out);
+        };
+        methods.xShmLock = [](sqlite3_file* f, int offset, int n, int flags) {
+            return realFile(f)->pMethods->xShmLock(realFile(f), offset, n, flags);
+        };
+        methods.xShmBarrier = [](sqlite3_file* f) { realFile(f)->pMethods->xShmBarrier(realFile(f)); };
+        methods.xShmUnmap = [](sqlite3_file* f, int deleteFlag) { return realFile(f)->pMethods->xShmUnmap(realFile(f), deleteFlag); };
+        methods.xFetch = [](sqlite3_file* f, sqlite3_int64 offset, int amount, void** out) {
+            return realFile(f)->pMethods->xFetch(realFile(f), offset, amount, out);
+        };
+        methods.xUnfetch = [](sqlite3_file* f, sqlite3_int64 offset, void* page) {
+            return realFile(f)->pMethods->xUnfetch(realFile(f), offset, page);
+        };
+        for (int version = 1; version <= 3; version++) {
+            tracedIoMethods[version - 1] = methods;
+            tracedIoMethods[version - 1].iVersion = version;  // SQLite only calls what the real file supports
+        }
+        sqlite3_vfs_register(&tracedVfs, 1);
+    }
+
+    bool TraceRecorder::enable(const string& path) {
+        if (active()) return true;  // Already on; the first file stays
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        origin = chrono::steady_clock::now();
+        installTracedVfs();
+        enabled = true;
+        nameThread("main");
+        return true;
+    }
+
+    TraceRecorder::~TraceRecorder() {
+        if (!active()) return;
+        enabled = false;  // Spans still open on other threads are dropped from here on
+        write();
+        close(fd);
+    }
+
+    ThreadTrace& TraceRecorder::local() {
+        thread_local ThreadTrace* mine = nullptr;
+        if (!mine) {
+            lock_guard<mutex> lock(mtx);
+            threads.push_back(new ThreadTrace());
+            mine = threads.back();
+            mine->thread = static_cast<int>(threads.size());
+        }
+        return *mine;
+    }
+
+    void TraceRecorder::nameThread(const string& name) {
+        if (!active()) return;
+        TraceRecorder& recorder = instance();
+        ThreadTrace& trace = recorder.local();
+        lock_guard<mutex> lock(recorder.mtx);
+        trace.name = name;
+    }
+
+    int TraceRecorder::busyWait(void*, int retries) {
+        static const int delays[] = {1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100};  // Milliseconds, as SQLite's own
+        const int steps = sizeof(delays) / sizeof(delays[0]);
+        int waited = 0;
+        for (int i = 0; i < min(retries, steps); i++) waited += delays[i];
+        if (retries > steps) waited += (retries - steps) * delays[steps - 1];
+        if (waited >= BUSY_TIMEOUT_MS) return 0;  // Give up: the statement fails with SQLITE_BUSY
+        int delay = min(delays[min(retries, steps - 1)], BUSY_TIMEOUT_MS - waited);
+
+        TraceSpan span("lock wait", "retry " + to_string(retries));
+        this_thread::sleep_for(chrono::milliseconds(delay));
+        return 1;
+    }
+
+    // Copies text into a fixed field, cutting it at a character boundary
+    static void copyTraceText(char* field, size_t size, string_view text) {
+        size_t n = min(text.size(), size - 1);
+        while (n > 0 && n < text.size() && (static_cast<unsigned char>(text[n]) & 0xC0) == 0x80) n--;
+        memcpy(field, text.data(), n);
+        field[n] = '\0';
+    }
+
+    bool TraceRecorder::beginChange(ThreadTrace& trace) {
+        // Both sequentially consistent: either write() sees the flag and waits, or this sees tracing off
+        trace.changing.store(true);
+        if (enabled.load()) return true;
+        trace.changing.store(false, memory_order_relaxed);
+        return false;
+    }
+
+    TraceSpan::TraceSpan(string_view name, string_view detail) {
+        if (!TraceRecorder::active()) return;
+        TraceRecorder& recorder = TraceRecorder::instance();
+        ThreadTrace& mine = recorder.local();
+        if (!TraceRecorder::beginChange(mine)) return;
+        trace = &mine;
+        sequence = trace->started++;
+        TraceEvent& event = trace->ring[sequence % TRACE_RING_EVENTS];
+        copyTraceText(event.name, sizeof(event.name), name);
+        copyTraceText(event.detail, sizeof(event.detail), detail);
+        event.sequence = sequence;
+        event.durationNanos = TRACE_OPEN;
+        event.startNanos = recorder.now();
+        TraceRecorder::endChange(mine);
+    }
+
+    TraceSpan::~TraceSpan() {
+        if (!trace || !TraceRecorder::beginChange(*trace)) return;
+        TraceEvent& event = trace->ring[sequence % TRACE_RING_EVENTS];
+        // A span open across TRACE_RING_EVENTS newer ones has lost its slot and is dropped
+        if (event.sequence == sequence) event.durationNanos = TraceRecorder::instance().now() - event.startNanos;
+        TraceRecorder::endChange(*trace);
+    }
+
+    void TraceRecorder::record(string_view name, string_view detail, chrono::steady_clock::time_point started,
+                               chrono::steady_clock::time_point ended) {
+        if (!active()) return;
+        TraceRecorder& recorder = instance();
+        ThreadTrace& trace = recorder.local();
+        if (!beginChange(trace)) return;
+        uint64_t sequence = trace.started++;
+        TraceEvent& event = trace.ring[sequence % TRACE_RING_EVENTS];
+        copyTraceText(event.name, sizeof(event.name), name);
+        copyTraceText(event.detail, sizeof(event.detail), detail);
+        event.sequence = sequence;
+        event.startNanos = chrono::duration_cast<chrono::nanoseconds>(started - recorder.origin).count();
+        event.durationNanos = chrono::duration_cast<chrono::nanoseconds>(ended - started).count();
+        endChange(trace);
+    }
+
+    atomic<bool> SqlProfiler::enabled{false};
+
+    SqlProfiler& SqlProfiler::instance() {
+        static SqlProfiler profiler;
+        return profiler;
+    }
+
+    void SqlProfiler::enable(double slowMillis, const string& path) {
+        if (active()) return;  // Already on; the first settings stay
+        slowNanos = static_cast<uint64_t>(slowMillis * 1e6);
+        slowLogPath = path;
+        logger = thread(&SqlProfiler::writeSlowQueries, this);
+        enabled = true;
+    }
+
+    SqlProfiler::~SqlProfiler() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        slowQueued.notify_one();
+        if (logger.joinable()) logger.join();
+    }
+
+    SqlProfiler::ThreadProfile& SqlProfiler::local() {
+        thread_local ThreadProfile* mine = nullptr;
+        if (!mine) {
+            lock_guard<mutex> lock(mtx);
+            threads.push_back(make_unique<ThreadProfile>());
+            mine = threads.back().get();
+            mine->thread = static_cast<int>(threads.size());
+        }
+        return *mine;
+    }
+
+    int SqlProfiler::trace(unsigned type, void*, void* p, void* x) {
+        ThreadMetrics& metrics = MetricsRegistry::instance().local();
+        sqlite3_stmt* stmt = static_cast<sqlite3_stmt*>(p);
+        // SQLite reports each execution's end once: when it finishes, is reset or is finalized
+        auto running = find_if(metrics.running.rbegin(), metrics.running.rend(),
+                               [stmt](const RunningStatement& r) { return r.stmt == stmt; });
+        if (type == SQLITE_TRACE_ROW) {
+            bump(metrics.rows);
+            if (running != metrics.running.rend()) running->rows++;
+        } else if (type == SQLITE_TRACE_STMT) {
+            bump(metrics.statements);
+            if (strncmp(static_cast<const char*>(x), "--", 2) != 0) {  // Not a trigger starting
+                metrics.running.push_back(RunningStatement{stmt, chrono::steady_clock::now(), 0});
+            }
+        } else if (type == SQLITE_TRACE_PROFILE && running != metrics.running.rend()) {
+            auto now = chrono::steady_clock::now();
+            uint64_t nanos = chrono::duration_cast<chrono::nanoseconds>(now - running->started).count();
+            metrics.histogram(Metric::Sql).record(nanos, 1, running->rows);
+            TraceRecorder::record(METRIC_NAMES[static_cast<int>(Metric::Sql)], sqlite3_sql(stmt), running->started, now);
+            if (active()) instance().finished(stmt, nanos, running->rows);
+            metrics.running.erase(next(running).base());
+        }
+        return 0;
+    }
+
+    void SqlProfiler::finished(sqlite3_stmt* stmt, uint64_t nanos, uint64_t rows) {
+        ThreadProfile& profile = local();
+        uint64_t scanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+        const char* sql = sqlite3_sql(stmt);
+        {
+            lock_guard<mutex> lock(profile.mtx);
+            // Cached statements keep their address, so the normalized text is worked out once;
+            // the raw text is compared in case a finalized statement's address was reused.
+            // One-off statements would add an address each, so the map is emptied when full.
+            if (profile.known.size() >= PROFILE_KNOWN_STATEMENTS && !profile.known.count(stmt)) {
+                profile.known.clear();
+            }
+            auto& known = profile.known[stmt];
+            if (!known.second || known.first != sql) {
+                string key = normalize(sql);
+                StatementProfile& totals = profile.byText[key];
+                if (totals.sql.empty()) {
+                    totals.sql = key;
+                    totals.example = sql;
+                }
+                known = {sql, &totals};
+            }
+            StatementProfile& totals = *known.second;
+            totals.count++;
+            totals.totalNanos += nanos;
+            totals.maxNanos = max(totals.maxNanos, nanos);
+            totals.rows += rows;
+            totals.scanSteps += scanSteps;
+        }
+        if (nanos < slowNanos) return;
+
+        SlowQuery query{chrono::system_clock::now(), nanos, profile.thread, sql, "", scanSteps, ""};
+        if (char* expanded = sqlite3_expanded_sql(stmt)) {
+            query.expanded = expanded;
+            sqlite3_free(expanded);
+        }
+        const char* file = sqlite3_db_filename(sqlite3_db_handle(stmt), "main");
+        if (file) query.database = file;
+        {
+            lock_guard<mutex> lock(mtx);
+            slow.push_back(move(query));
+        }
+        slowQueued.notify_one();
+    }
+
+    // Replace string and number literals with ? and collapse runs of whitespace
+    string SqlProfiler::normalize(const char* sql) {
+        string out;
+        for (const char* c = sql; *c;) {
+            if (*c == '\'') {
+                for (c++; *c && !(*c == '\'' && c[1] != '\''); c += (*c == '\'' ? 2 : 1)) {}
+                if (*c) c++;
+                out += '?';
+            } else if (isdigit(static_cast<unsigned char>(*c)) &&  // Not part of a name or a ?NNN parameter
+                       (out.empty() || !(isalnum(static_cast<unsigned char>(out.back())) || out.back() == '_' ||
+                                         out.back() == '?'))) {
+                while (isalnum(static_cast<unsigned char>(*c)) || *c == '.') c++;
+                out += '?';
+            } else if (isspace(static_cast<unsigned char>(*c))) {
+                while (isspace(static_cast<unsigned char>(*c))) c++;
+                if (!out.empty() && *c) out += ' ';
+            } else {
+                out += *c++;
+            }
+        }
+        return out;
+    }
+
+    void SqlProfiler::snapshot(vector<StatementProfile>& profiles) {
+        unordered_map<string, StatementProfile> merged;
+        {
+            lock_guard<mutex> lock(mtx);
+            for (const auto& thread : threads) {
+                lock_guard<mutex> threadLock(thread->mtx);
+                for (const auto& entry : thread->byText) {
+                    StatementProfile& total = merged[entry.first];
+                    total.sql = entry.first;
+                    total.example = entry.second.example;
+                    total.count += entry.second.count;
+                    total.totalNanos += entry.second.totalNanos;
+                    total.maxNanos = max(total.maxNanos, entry.second.maxNanos);
+                    total.rows += entry.second.rows;
+                    total.scanSteps += entry.second.scanSteps;
+                }
+            }
+        }
+        profiles.clear();
+        for (auto& entry : merged) profiles.push_back(move(entry.second));
+        sort(profiles.begin(), profiles.end(), [](const StatementProfile& a, const StatementProfile& b) {
+            return a.totalNanos > b.totalNanos;
+        });
+    }
+
+    // Logger thread: explain and append each slow execution
+    void SqlProfiler::writeSlowQueries() {
+        TraceRecorder::nameThread("slow-query log");
+        sqlite3* db = nullptr;  // Own connection, opened on the first slow query
+        ofstream log;
+        unique_lock<mutex> lock(mtx);
+        while (true) {
+            slowQueued.wait(lock, [this] { return stopping || !slow.empty(); });
+            if (slow.empty()) break;
+            SlowQuery query = move(slow.front());
+            slow.pop_front();
+            lock.unlock();
+
+            if (!db && sqlite3_open_v2(query.database.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK) {
+                sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+            }
+            string plan;
+            sqlite3_stmt* explain = nullptr;
+            if (db && sqlite3_prepare_v2(db, ("EXPLAIN QUERY PLAN " + query.sql).c_str(), -1, &explain, nullptr) == SQLITE_OK) {
+                map<int, int> depth;  // Plan node id -> indentation
+                while (sqlite3_step(explain) == SQLITE_ROW) {
+                    int id = sqlite3_column_int(explain, 0), parent = sqlite3_column_int(explain, 1);
+                    depth[id] = depth.count(parent) ? depth[parent] + 1 : 1;
+                    plan += string(2 * depth[id], ' ') + reinterpret_cast<const char*>(sqlite3_column_text(explain, 3)) + "\n";
+                }
+            } else {
+                plan = string("  (no plan: ") + (db ? sqlite3_errmsg(db) : "database not open") + ")\n";
+            }
+            sqlite3_finalize(explain);
+
+            if (!log.is_open()) log.open(slowLogPath, ios::app);
+            time_t seconds = chrono::system_clock::to_time_t(query.when);
+            tm local;
+            localtime_r(&seconds, &local);
+            log << put_time(&local, "%Y-%m-%d %H:%M:%S") << "  " << fixed << setprecision(3) << query.nanos / 1e6
+                << " ms  thread " << query.thread << "  full-scan steps " << query.scanSteps << "\n"
+                << (query.expanded.empty() ? query.sql : query.expanded) << "\n" << plan << "\n";
+            log.flush();
+            slowLogged++;
+            lock.lock();
+        }
+        if (db) sqlite3_close(db);
+    }
+
+    StatementHandle::StatementHandle(const string& sql) {
+        conn = ConnectionPool::instance().acquire();
+        if (conn) {
+            stmt = conn->statements.acquire(conn->db, sql, cached);
+        }
+    }
+
+    StatementHandle::~StatementHandle() {
+        if (!stmt) return;
+        if (cached) conn->statements.release(stmt);
+        else sqlite3_finalize(stmt);
+    }
+
+    CheckpointManager& CheckpointManager::instance() {
+        ConnectionPool::instance();  // The pool must outlive the checkpoint thread's connection
+        static CheckpointManager manager;
+        return manager;
+    }
+
+    CheckpointManager::CheckpointManager() : worker(&CheckpointManager::run, this) {}
+
+    CheckpointManager::~CheckpointManager() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    void CheckpointManager::noteCommit(int walFrames) {
+        bool large;
+        {
+            lock_guard<mutex> lock(mtx);
+            counters.commits++;
+            counters.walFrames = walFrames;
+            lastCommit = chrono::steady_clock::now();
+            large = walFrames >= storageConfig.passiveCheckpointFrames;
+        }
+        if (large) wake.notify_one();  // Don't wait for the next interval
+    }
+
+    StorageStats CheckpointManager::stats() {
+        lock_guard<mutex> lock(mtx);
+        return counters;
+    }
+
+    void CheckpointManager::run() {
+        TraceRecorder::nameThread("checkpoint");
+        unique_lock<mutex> lock(mtx);
+        while (!stopping) {
+            wake.wait_for(lock, chrono::milliseconds(storageConfig.checkpointIntervalMs));
+            if (stopping) break;
+
+            bool quiet = chrono::steady_clock::now() - lastCommit >=
+                         chrono::milliseconds(storageConfig.quietPeriodMs);
+            int mode = -1;
+            if (counters.walFrames >= storageConfig.passiveCheckpointFrames) {
+                mode = SQLITE_CHECKPOINT_PASSIVE;   // Copy back what readers allow, never block
+            }
+            if (quiet && counters.walFrames > 0) {
+                mode = SQLITE_CHECKPOINT_TRUNCATE;  // Nobody is writing: reset the WAL to zero bytes
+            }
+            if (mode < 0) continue;
+
+            lock.unlock();  // Commits keep reporting while the checkpoint runs
+            checkpoint(mode);
+            lock.lock();
+        }
+    }
+
+    bool CheckpointManager::checkpoint(int mode) {
+        sqlite3* db = getConnection();
+        if (!db) return false;
+        int logFrames = 0, copiedFrames = 0;
+        // TRUNCATE holds off writers while it waits for readers, so it must not wait: without a
+        // busy handler it copies what readers allow, like PASSIVE, and reports SQLITE_BUSY
+        if (mode == SQLITE_CHECKPOINT_TRUNCATE) sqlite3_busy_timeout(db, 0);
+        int rc = sqlite3_wal_checkpoint_v2(db, nullptr, mode, &logFrames, &copiedFrames);
+        if (mode == SQLITE_CHECKPOINT_TRUNCATE) waitForLocks(db);  // The connection goes back to the pool
+
+        lock_guard<mutex> lock(mtx);
+        if (rc == SQLITE_BUSY || (rc == SQLITE_OK && copiedFrames < logFrames)) {
+            counters.busyCheckpoints++;   // Readers or a writer held back part of the WAL
+        }
+        if (rc == SQLITE_BUSY && copiedFrames > 0) counters.framesCheckpointed += copiedFrames;
+        if (rc != SQLITE_OK) return false;
+        if (mode == SQLITE_CHECKPOINT_TRUNCATE) counters.truncateCheckpoints++;
+        else counters.passiveCheckpoints++;
+        counters.framesCheckpointed += copiedFrames;
+        // A completed checkpoint lets the next writer restart the WAL from the beginning
+        if (copiedFrames == logFrames) counters.walFrames = 0;
+        return true;
+    }
+
+    // Runs a statement that returns no rows on the calling thread's connection
+    static bool runStatement(const char* sql) {
+        StatementHandle stmt(sql);
+        if (!stmt) return false;
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+            cerr << "SQL error: " << sqlite3_errmsg(sqlite3_db_handle(stmt.get())) << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Publishes what the connection's last transaction changed, once it has committed
+    // (or rolled back - the changed rows are then simply re-read unchanged)
+    static void afterCommit(Connection* conn) {
+        FlightCatalog::instance().noteLocalCommit();
+        if (conn->changedFlights.empty()) return;
+        vector<sqlite3_int64> rowids;
+        rowids.swap(conn->changedFlights);
+        FlightCatalog::instance().refreshRows(rowids);
+    }
+
+    Transaction::Transaction() {
+        sqlite3* db = getConnection();
+        if (!db) return;
+        nested = !sqlite3_get_autocommit(db);  // An outer transaction is already open
+        TraceSpan span(nested ? "savepoint" : "begin");
+        open = runStatement(nested ? "SAVEPOINT txn;" : "BEGIN IMMEDIATE;");
+    }
+
+    Transaction::~Transaction() {
+        if (open) rollback();
+    }
+
+    bool Transaction::commit() {
+        if (!open) return false;
+        TraceSpan span(nested ? "release" : "commit");
+        if (!runStatement(nested ? "RELEASE txn;" : "COMMIT;")) {
+            rollback();
+            return false;
+        }
+        open = false;
+        if (!nested) afterCommit(ConnectionPool::instance().acquire());
+        return true;
+    }
+
+    void Transaction::rollback() {
+        if (!open) return;
+        TraceSpan span("rollback");
+        if (nested) {
+            runStatement("ROLLBACK TO txn;");  // Undo the savepoint's changes...
+            runStatement("RELEASE txn;");      // ...and remove it from the stack
+        } else {
+            if (!sqlite3_get_autocommit(getConnection())) {
+                runStatement("ROLLBACK;");     // SQLite may already have rolled back on error
+            }
+            afterCommit(ConnectionPool::instance().acquire());
+        }
+        open = false;
+    }
+
+    sqlite3* getConnection() {
+        Connection* conn = ConnectionPool::instance().acquire();
+        return conn ? conn->db : nullptr;
+    }
+
+    bool executeSQL(const string& sql) {
+        sqlite3* db = getConnection();   // Pooled database connection
+        char* errMsg = nullptr;          // For storing error messages
+        bool success = false;            // Return status
+
+        if (db) {  // Connection is available
+            // Execute SQL command
+            if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+                /*
+                db: Database connection
+
+                sql.c_str(): The SQL command to execute (converted to C-style string)
+
+                nullptr: No callback function (since we're not processing row results)
+
+                nullptr: No data to pass to callback
+
+                &errMsg: Address to store any error message
+                
+                */
+                cerr << "SQL error: " << errMsg << endl;  // Print error if any
+                sqlite3_free(errMsg);     // Free error message memory
+            } else {
+                success = true;           // Mark as successful
+            }
+            if (sqlite3_get_autocommit(db)) {
+                afterCommit(ConnectionPool::instance().acquire());  // Statement committed on its own
+            }
+        }
+        return success;
+    }
+
+// Function to execute SQL query with a callback function
+bool executeSQLWithCallback(const string& sql, int (*callback)(void*, int, char**, char**), void* data) {
+    sqlite3* db = getConnection();  // Pooled database handle
+    char* errMsg = nullptr;  // Error message pointer
+    bool success = false;  // Success flag
+
+    if (db) {
+        // Execute SQL query with callback
+        if (sqlite3_exec(db, sql.c_str(), callback, data, &errMsg) != SQLITE_OK) {
+            cerr << "SQL error: " << errMsg << endl;  // Print error if query fails
+            sqlite3_free(errMsg);  // Free error message memory
+        } else {
+            success = true;  // Set success flag if query succeeds
+        }
+    }
+
+    return success;  // Return success status
+}
+
+// Check if a flight exists in the database
+bool flightExists(const string& flightNumber) {
+    OperationTimer timer(Metric::FlightExists);
+    // Answered from the in-memory flight catalog; no SQL unless another process wrote
+    return FlightCatalog::instance().contains(flightNumber);
+}
+
+// Check if a user exists in the database
+bool userExists(const string& userID) {
+    OperationTimer timer(Metric::UserExists);
+    StatementHandle stmt("SELECT 1 FROM Passengers WHERE userID = ?;");  // Cached statement
+    bool exists = false;  // Existence flag
+
+    if (stmt) {
+        sqlite3_bind_text(stmt.get(), 1, userID.c_str(), -1, SQLITE_STATIC);  // Bind parameter
+        if (sqlite3_step(stmt.get()) == SQLITE_ROW) {  // Execute query
+            exists = true;  // Set flag if user exists
+        }
+    }
+
+    return exists;  // Return existence status
+}
+
+// Check if a seat is available on a flight
+bool isSeatAvailable(const string& flightNumber, int seatNumber) {
+    OperationTimer timer(Metric::IsSeatAvailable);
+    // Answered from the flight's in-memory seat map; loaded once per flight
+    shared_ptr<SeatMap> seats = SeatIndex::instance().get(flightNumber);
+    return !seats || !seats->isTaken(seatNumber);  // Unknown flights have no taken seats
+}
+
+// Get list of taken seats for a flight
+vector<int> getTakenSeats(const string& flightNumber) {
+    OperationTimer timer(Metric::GetTakenSeats);
+    shared_ptr<SeatMap> seats = SeatIndex::instance().get(flightNumber);  // In-memory seat map
+    return seats ? seats->takenSeats() : vector<int>();
+}
+
+SeatMap::SeatMap(int capacity, const vector<int>& takenSeats)
+    : seatCount(capacity > 0 ? capacity : 0),
+      words((seatCount + 63) / 64 + 1) {  // One spare word keeps scans branch-free at the end
+    vector<uint64_t> bits(words.size(), 0);
+    // Bits past the last seat count as taken
+    for (size_t bit = seatCount; bit < bits.size() * 64; bit++) {
+        bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+    for (int seat : takenSeats) {
+        if (seat >= 1 && seat <= seatCount) bits[(seat - 1) / 64] |= 1ULL << ((seat - 1) % 64);
+        else outOfRangeSeats.push_back(seat);
+    }
+    sort(outOfRangeSeats.begin(), outOfRangeSeats.end());
+    for (size_t w = 0; w < bits.size(); w++) {
+        words[w].store(bits[w], memory_order_relaxed);  // Published with the shared_ptr
+    }
+}
+
+bool SeatMap::isTaken(int seat) const {
+    if (seat < 1 || seat > seatCount) {
+        lock_guard<mutex> lock(legacyMtx);
+        return binary_search(outOfRangeSeats.begin(), outOfRangeSeats.end(), seat);
+    }
+    return words[(seat - 1) / 64].load(memory_order_acquire) >> ((seat - 1) % 64) & 1;
+}
+
+bool SeatMap::tryClaim(int seat) {
+    if (seat < 1 || seat > seatCount) return false;
+    uint64_t mask = 1ULL << ((seat - 1) % 64);
+    // Only the thread that flips the bit from 0 to 1 owns the seat
+    return !(words[(seat - 1) / 64].fetch_or(mask, memory_order_acq_rel) & mask);
+}
+
+void SeatMap::release(int seat) {
+    if (seat < 1 || seat > seatCount) {
+        lock_guard<mutex> lock(legacyMtx);
+        outOfRangeSeats.erase(remove(outOfRangeSeats.begin(), outOfRangeSeats.end(), seat),
+                              outOfRangeSeats.end());
+        return;
+    }
+    words[(seat - 1) / 64].fetch_and(~(1ULL << ((seat - 1) % 64)), memory_order_acq_rel);
+}
+
+vector<int> SeatMap::takenSeats() const {
+    vector<int> seats;
+    vector<int> legacy;
+    {
+        lock_guard<mutex> lock(legacyMtx);
+        legacy = outOfRangeSeats;
+    }
+    // Legacy seats below 1 sort before the bitmap, those above capacity after it
+    auto firstAbove = upper_bound(legacy.begin(), legacy.end(), 0);
+    seats.insert(seats.end(), legacy.begin(), firstAbove);
+
+    size_t usedWords = (seatCount + 63) / 64;
+    for (size_t w = 0; w < usedWords; w++) {
+        uint64_t bits = words[w].load(memory_order_acquire);
+        if (w == usedWords - 1 && seatCount % 64) {
+            bits &= (1ULL << (seatCount % 64)) - 1;  // Ignore padding bits past the last seat
+        }
+        while (bits) {  // Visit set bits only, lowest first
+            seats.push_back(int(w * 64) + __builtin_ctzll(bits) + 1);
+            bits &= bits - 1;
+        }
+    }
+
+    seats.insert(seats.end(), firstAbove, legacy.end());
+    return seats;
+}
+
+// Finds the first word at or after start that has a free seat (a zero bit)
+static size_t nextOpenWordScalar(const uint64_t* words, size_t count, size_t start) {
+    for (size_t w = start; w < count; w++) {
+        if (words[w] != ~0ULL) return w;
+    }
+    return count;
+}
+
+#ifdef SEAT_SCAN_AVX2
+// Same as nextOpenWordScalar, comparing four words (256 seats) per instruction
+__attribute__((target("avx2")))
+static size_t nextOpenWordAvx2(const uint64_t* words, size_t count, size_t start) {
+    const __m256i full = _mm256_set1_epi64x(-1);
+    size_t w = start;
+    for (; w + 4 <= count; w += 4) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + w));
+        int fullMask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(block, full)));
+        if (fullMask != 0xF) return w + __builtin_ctz(~fullMask & 0xF);  // First word with a free bit
+    }
+    return nextOpenWordScalar(words, count, w);
+}
+#endif
+
+// Picks the scan for this CPU once
+static size_t nextOpenWord(const uint64_t* words, size_t count, size_t start) {
+#ifdef SEAT_SCAN_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2) return nextOpenWordAvx2(words, count, start);
+#endif
+    return nextOpenWordScalar(words, count, start);
+}
+
+int SeatMap::firstFreeSeat() const {
+    return firstFreeRun(1);
+}
+
+int SeatMap::freeSeatCount() const {
+    int free = 0;
+    for (const atomic<uint64_t>& word : words) {  // Padding bits past the last seat are set
+        free += 64 - __builtin_popcountll(word.load(memory_order_relaxed));
+    }
+    return free;
+}
+
+int SeatMap::firstFreeRun(int count) const {
+    if (count < 1 || count > seatCount) return 0;
+
+    // Scan a plain copy of the words: the vector scan can't load atomics directly, and
+    // a seat freed or taken meanwhile is settled by tryClaim anyway
+    static thread_local vector<uint64_t> snapshot;
+    snapshot.resize(words.size());
+    for (size_t w = 0; w < words.size(); w++) {
+        snapshot[w] = words[w].load(memory_order_relaxed);
+    }
+    const vector<uint64_t>& bits = snapshot;
+
+    // Padding bits past the last seat are set, so no run can extend beyond the flight
+    size_t total = bits.size();
+    size_t runStart = 0;  // Bit index where the current run of free seats began
+    int run = 0;          // Length of the free run ending at the current word boundary
+    for (size_t w = nextOpenWord(bits.data(), total, 0); w < total;
+         w = nextOpenWord(bits.data(), total, w + 1)) {
+        if (w > 0 && bits[w - 1] == ~0ULL) run = 0;  // Skipped full words break the run
+        uint64_t taken = bits[w];
+
+        if (taken == 0) {  // All 64 seats free - extend the run
+            if (run == 0) runStart = w * 64;
+            run += 64;
+            if (run >= count) return int(runStart) + 1;
+            continue;
+        }
+
+        // Free seats at the bottom of this word continue the run from the previous word
+        int low = __builtin_ctzll(taken);
+        if (run == 0) runStart = w * 64;
+        if (run + low >= count) return int(runStart) + 1;
+
+        // A run inside the word: bit i of mask ends up set iff bits i..i+count-1 are all free
+        if (count <= 64) {
+            uint64_t mask = ~taken;
+            for (int width = 1; width < count; ) {
+                int step = min(width, count - width);
+                mask &= mask >> step;
+                width += step;
+            }
+            if (mask) return int(w * 64) + __builtin_ctzll(mask) + 1;
+        }
+
+        // Free seats at the top of this word may start a run into the next one
+        run = __builtin_clzll(taken);
+        runStart = w * 64 + 64 - run;
+    }
+    return 0;
+}
+
+SeatIndex& SeatIndex::instance() {
+    static SeatIndex index;
+    return index;
+}
+
+shared_ptr<SeatMap> SeatIndex::get(const string& flightNumber) {
+    FlightCatalog::instance().checkExternalChanges();  // May drop every map another process changed
+    {
+        shared_lock<shared_mutex> lock(mtx);
+        auto found = maps.find(flightNumber);
+        if (found != maps.end()) return found->second;  // Already loaded
+    }
+
+    while (true) {
+        uint64_t version;
+        {
+            shared_lock<shared_mutex> lock(mtx);
+            auto found = versions.find(flightNumber);
+            version = generation + (found == versions.end() ? 0 : found->second);
+        }
+
+        // Capacity from the flight catalog, bookings from the database
+        Flight flight;
+        if (!FlightCatalog::instance().find(flightNumber, flight)) return nullptr;  // No such flight
+        int capacity = flight.totalTickets;
+
+        vector<int> taken;
+        {
+            StatementHandle stmt("SELECT seatNumber FROM Bookings "
+                                 "WHERE flightID = (SELECT id FROM Flights WHERE flightNumber = ?);");
+            if (!stmt) return nullptr;
+            sqlite3_bind_text(stmt.get(), 1, flightNumber.c_str(), -1, SQLITE_STATIC);
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                taken.push_back(sqlite3_column_int(stmt.get(), 0));
+            }
+        }
+        auto loaded = make_shared<SeatMap>(capacity, taken);
+
+        unique_lock<shared_mutex> lock(mtx);
+        auto found = maps.find(flightNumber);
+        if (found != maps.end()) return found->second;  // Another thread won the race
+        auto seen = versions.find(flightNumber);
+        if (generation + (seen == versions.end() ? 0 : seen->second) != version) {
+            continue;  // A booking or invalidation landed mid-load - read again
+        }
+        maps[flightNumber] = loaded;
+        return loaded;
+    }
+}
+
+void SeatIndex::update(const string& flightNumber, int seat, bool taken) {
+    shared_ptr<SeatMap> seats;
+    {
+        unique_lock<shared_mutex> lock(mtx);
+        versions[flightNumber]++;  // Invalidates any load of this flight in progress
+        auto found = maps.find(flightNumber);
+        if (found == maps.end()) return;  // Not loaded - the next load reads the change
+        seats = found->second;
+    }
+    if (taken) seats->tryClaim(seat);
+    else seats->release(seat);
+}
+
+void SeatIndex::invalidate(const string& flightNumber) {
+    unique_lock<shared_mutex> lock(mtx);
+    versions[flightNumber]++;
+    maps.erase(flightNumber);
+}
+
+void SeatIndex::clear() {
+    unique_lock<shared_mutex> lock(mtx);
+    generation++;
+    maps.clear();
+}
+
+// Columns read for every cached flight: the rowid first, then FLIGHT_ROW
+static const string FLIGHT_CATALOG_COLUMNS = "SELECT rowid, " + FLIGHT_ROW.selectList() + " FROM Flights";
+
+static int64_t steadyNow() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FlightCatalog& FlightCatalog::instance() {
+    static FlightCatalog catalog;
+    return catalog;
+}
+
+bool FlightCatalog::load() {
+    while (true) {
+        uint64_t seq;
+        {
+            shared_lock<shared_mutex> lock(mtx);
+            seq = changeSeq;
+        }
+
+        unordered_map<string, Flight> loaded;
+        unordered_map<sqlite3_int64, string> rowids;
+        RouteGraph loadedRoutes;
+        {
+            StatementHandle stmt(FLIGHT_CATALOG_COLUMNS + ";");
+            if (!stmt) return false;
+            auto columns = FLIGHT_ROW.bind(stmt.get());
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                Flight flight;
+                columns.read(stmt.get(), flight);
+                rowids[sqlite3_column_int64(stmt.get(), 0)] = flight.flightNumber;
+                loadedRoutes.add(flight);
+                loaded[flight.flightNumber] = move(flight);
+            }
+        }
+
+        unique_lock<shared_mutex> lock(mtx);
+        if (changeSeq != seq) continue;  // A commit was published mid-load - read again
+        flights.swap(loaded);
+        numberByRowid.swap(rowids);
+        swap(routes, loadedRoutes);
+        lastLoad = steadyNow();
+        fullLoads++;
+        return true;
+    }
+}
+
+bool FlightCatalog::find(const string& flightNumber, Flight& flight) {
+    Connection* conn = ConnectionPool::instance().acquire();
+    if (conn && !conn->changedFlights.empty()) {
+        // This thread's open transaction changed Flights; only SQL sees those changes yet
+        StatementHandle stmt(FLIGHT_CATALOG_COLUMNS + " WHERE flightNumber = ?;");
+        if (!stmt) return false;
+        sqlite3_bind_text(stmt.get(), 1, flightNumber.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_ROW) return false;
+        FLIGHT_ROW.bind(stmt.get()).read(stmt.get(), flight);
+        return true;
+    }
+
+    checkExternalChanges();
+    shared_lock<shared_mutex> lock(mtx);
+    auto found = flights.find(flightNumber);
+    if (found == flights.end()) return false;
+    flight = found->second;
+    return true;
+}
+
+bool FlightCatalog::contains(const string& flightNumber) {
+    Flight flight;
+    return find(flightNumber, flight);
+}
+
+size_t FlightCatalog::size() {
+    shared_lock<shared_mutex> lock(mtx);
+    return flights.size();
+}
+
+void FlightCatalog::refreshRows(const vector<sqlite3_int64>& rowids) {
+    // Read the committed rows first, then apply them all under one lock
+    vector<pair<sqlite3_int64, Flight>> present;
+    vector<sqlite3_int64> gone;
+    {
+        StatementHandle stmt(FLIGHT_CATALOG_COLUMNS + " WHERE rowid = ?;");
+        if (!stmt) return;
+        auto columns = FLIGHT_ROW.bind(stmt.get());
+        for (sqlite3_int64 rowid : rowids) {
+            sqlite3_bind_int64(stmt.get(), 1, rowid);
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                present.emplace_back(rowid, Flight());
+                columns.read(stmt.get(), present.back().second);
+            } else {
+                gone.push_back(rowid);
+            }
+            sqlite3_reset(stmt.get());
+        }
+    }
+
+    unique_lock<shared_mutex> lock(mtx);
+    changeSeq++;
+    for (sqlite3_int64 rowid : gone) {
+        auto found = numberByRowid.find(rowid);
+        if (found == numberByRowid.end()) continue;
+        auto flight = flights.find(found->second);
+        if (flight != flights.end()) {
+            routes.remove(flight->second);
+            flights.erase(flight);
+        }
+        numberByRowid.erase(found);
+    }
+    for (auto& row : present) {
+        auto previous = numberByRowid.find(row.first);
+        if (previous != numberByRowid.end()) {
+            // Drop the old row's route; the flight number may have changed in place too
+            auto flight = flights.find(previous->second);
+            if (flight != flights.end()) {
+                routes.remove(flight->second);
+                if (previous->second != row.second.flightNumber) flights.erase(flight);
+            }
+        }
+        numberByRowid[row.first] = row.second.flightNumber;
+        routes.add(row.second);
+        flights[row.second.flightNumber] = move(row.second);
+    }
+}
+
+void FlightCatalog::RouteGraph::add(const Flight& flight) {
+    set<string>& numbers = departures[flight.startingPoint][flight.destination];
+    if (numbers.empty()) arrivals[flight.destination].insert(flight.startingPoint);  // New city pair
+    numbers.insert(flight.flightNumber);
+}
+
+void FlightCatalog::RouteGraph::remove(const Flight& flight) {
+    auto origin = departures.find(flight.startingPoint);
+    if (origin == departures.end()) return;
+    auto destination = origin->second.find(flight.destination);
+    if (destination == origin->second.end()) return;
+    destination->second.erase(flight.flightNumber);
+    if (destination->second.empty()) {
+        // Last flight on this city pair
+        origin->second.erase(destination);
+        auto inbound = arrivals.find(flight.destination);
+        inbound->second.erase(flight.startingPoint);
+        if (inbound->second.empty()) arrivals.erase(inbound);
+    }
+    if (origin->second.empty()) departures.erase(origin);
+}
+
+// First string after every string that begins with prefix, or "" if there is none
+static string prefixEnd(string prefix) {
+    while (!prefix.empty() && static_cast<unsigned char>(prefix.back()) == 0xFF) prefix.pop_back();
+    if (!prefix.empty()) prefix.back()++;
+    return prefix;
+}
+
+// Visit the entries of an ordered map whose key equals city, or begins with it for a prefix
+template <typename Map, typename Fn>
+static void forEachCity(Map& cities, const string& city, bool prefix, Fn&& fn) {
+    if (!prefix) {
+        auto found = cities.find(city);
+        if (found != cities.end()) fn(found->second);
+        return;
+    }
+    for (auto it = cities.lower_bound(city); it != cities.end() && it->first.compare(0, city.size(), city) == 0; ++it) {
+        fn(it->second);
+    }
+}
+
+bool FlightCatalog::searchRoutes(const string& from, bool fromPrefix, const string& to, bool toPrefix,
+                                 vector<Flight>& found) {
+    found.clear();
+    if (to.empty()) toPrefix = true;  // Any destination
+
+    Connection* conn = ConnectionPool::instance().acquire();
+    if (conn && !conn->changedFlights.empty()) {
+        // This thread's open transaction changed Flights; ask the route index instead
+        string sql = FLIGHT_CATALOG_COLUMNS + " WHERE ";
+        vector<string> values;
+        auto match = [&](const char* column, const string& city, bool prefix) {
+            if (!prefix) {
+                sql += string(column) + " = ? AND ";
+                values.push_back(city);
+                return;
+            }
+            sql += string(column) + " >= ? AND ";
+            values.push_back(city);
+            string end = prefixEnd(city);
+            if (!end.empty()) {
+                sql += string(column) + " < ? AND ";
+                values.push_back(end);
+            }
+        };
+        match("startingPoint", from, fromPrefix);
+        match("destination", to, toPrefix);
+        sql += "availableTickets > 0 ORDER BY availableTickets DESC, flightNumber;";
+
+        StatementHandle stmt(sql);
+        if (!stmt) return false;
+        for (size_t i = 0; i < values.size(); i++) {
+            sqlite3_bind_text(stmt.get(), int(i + 1), values[i].c_str(), -1, SQLITE_STATIC);
+        }
+        return FLIGHT_ROW.forEach(stmt.get(), [&](Flight& flight) { found.push_back(move(flight)); });
+    }
+
+    checkExternalChanges();
+    {
+        shared_lock<shared_mutex> lock(mtx);
+        forEachCity(routes.departures, from, fromPrefix, [&](const map<string, set<string>>& destinations) {
+            forEachCity(destinations, to, toPrefix, [&](const set<string>& numbers) {
+                for (const string& number : numbers) {
+                    const Flight& flight = flights.at(number);
+                    if (flight.availableTickets > 0) found.push_back(flight);
+                }
+            });
+        });
+    }
+    sort(found.begin(), found.end(), [](const Flight& a, const Flight& b) {
+        if (a.availableTickets != b.availableTickets) return a.availableTickets > b.availableTickets;
+        return a.flightNumber < b.flightNumber;
+    });
+    return true;
+}
+
+bool FlightCatalog::findConnections(const string& from, const string& to, int maxLegs, size_t maxResults,
+                                    vector<vector<Flight>>& found) {
+    OperationTimer timer(Metric::FindConnections);
+    found.clear();
+    Connection* conn = ConnectionPool::instance().acquire();
+    if (conn && !conn->changedFlights.empty()) {
+        // This thread's open transaction changed Flights; search a graph of what it sees
+        unordered_map<string, Flight> current;
+        RouteGraph graph;
+        StatementHandle stmt("SELECT " + FLIGHT_ROW.selectList() + " FROM Flights WHERE availableTickets > 0;");
+        if (!stmt) return false;
+        bool ok = FLIGHT_ROW.forEach(stmt.get(), [&](Flight& flight) {
+            graph.add(flight);
+            current[flight.flightNumber] = move(flight);
+        });
+        if (!ok) return false;
+        connect(graph, current, from, to, maxLegs, maxResults, found);
+        return true;
+    }
+
+    checkExternalChanges();
+    shared_lock<shared_mutex> lock(mtx);
+    connect(routes, flights, from, to, maxLegs, maxResults, found);
+    return true;
+}
+
+// Bounded search: a backward BFS from the destination gives each city's fewest legs to
+// arrive, then a depth-first walk from the origin only follows flights that can still
+// arrive within the legs left, for 1 leg, then 2, up to maxLegs
+void FlightCatalog::connect(const RouteGraph& routes, const unordered_map<string, Flight>& flights,
+                            const string& from, const string& to, int maxLegs, size_t maxResults,
+                            vector<vector<Flight>>& found) {
+    if (from == to || maxLegs < 1 || maxResults == 0) return;
+
+    // A city pair counts as an edge only while one of its flights has tickets left
+    auto open = [&](const set<string>& numbers) {
+        for (const string& number : numbers) {
+            if (flights.at(number).availableTickets > 0) return true;
+        }
+        return false;
+    };
+
+    unordered_map<string, int> legsToGo{{to, 0}};
+    vector<string> frontier{to};
+    for (int legs = 1; legs <= maxLegs && !frontier.empty(); legs++) {
+        vector<string> next;
+        for (const string& city : frontier) {
+            auto inbound = routes.arrivals.find(city);
+            if (inbound == routes.arrivals.end()) continue;
+            for (const string& origin : inbound->second) {
+                if (legsToGo.count(origin)) continue;
+                if (!open(routes.departures.at(origin).at(city))) continue;
+                legsToGo[origin] = legs;
+                next.push_back(origin);
+            }
+        }
+        frontier.swap(next);
+    }
+
+    vector<Flight> path;
+    vector<string> visited{from};
+    function<void(const string&, int)> walk = [&](const string& city, int legsLeft) {
+        auto departures = routes.departures.find(city);
+        if (departures == routes.departures.end()) return;
+        for (const auto& [destination, numbers] : departures->second) {
+            auto reach = legsToGo.find(destination);
+            // Exactly legsLeft legs: shorter itineraries were found on an earlier pass
+            if (reach == legsToGo.end() || reach->second > legsLeft - 1) continue;
+            if (destination == to ? legsLeft != 1
+                                  : std::find(visited.begin(), visited.end(), destination) != visited.end()) {
+                continue;
+            }
+            for (const string& number : numbers) {
+                const Flight& flight = flights.at(number);
+                if (flight.availableTickets <= 0) continue;
+                path.push_back(flight);
+                if (destination == to) {
+                    if (legsLeft == 1) found.push_back(path);
+                } else {
+                    visited.push_back(destination);
+                    walk(destination, legsLeft - 1);
+                    visited.pop_back();
+                }
+                path.pop_back();
+                if (found.size() >= maxResults) return;
+            }
+        }
+    };
+    auto reach = legsToGo.find(from);
+    if (reach == legsToGo.end()) return;  // Not reachable within maxLegs
+    for (int legs = reach->second; legs <= maxLegs && found.size() < maxResults; legs++) {
+        walk(from, legs);
+    }
+}
+
+void FlightCatalog::checkExternalChanges() {
+    int64_t now = steadyNow();
+    int64_t due = nextCheck.load(memory_order_relaxed);
+    if (now < due || !nextCheck.compare_exchange_strong(due, now + CATALOG_CHECK_INTERVAL_MS)) {
+        return;  // Checked recently, or another thread is checking right now
+    }
+
+    Connection* conn = ConnectionPool::instance().acquire();
+    if (!conn || !sqlite3_get_autocommit(conn->db)) return;  // Inside a transaction: check later
+    long long version = -1;
+    uint64_t commits = localCommits.load(memory_order_relaxed);
+    {
+        StatementHandle stmt("PRAGMA data_version;");
+        if (!stmt || sqlite3_step(stmt.get()) != SQLITE_ROW) return;
+        version = sqlite3_column_int64(stmt.get(), 0);
+    }
+
+    bool changed = conn->dataVersion >= 0 && version != conn->dataVersion;
+    bool ourCommits = commits != conn->seenLocalCommits;
+    conn->dataVersion = version;
+    conn->seenLocalCommits = commits;
+
+    if (changed && !ourCommits) {
+        // Only another process can have written: everything cached may be stale
+        suspect = false;
+        load();
+        SeatIndex::instance().clear();
+        return;
+    }
+    // Our own commits moved data_version too, so another process's write can't be
+    // ruled out; reload once the catalog is older than CATALOG_MAX_STALENESS_MS. The seat
+    // maps go too: data_version has been consumed, so nothing else would refresh them.
+    if (changed) suspect = true;
+    if (suspect && now - lastLoad.load(memory_order_relaxed) >= CATALOG_MAX_STALENESS_MS) {
+        suspect = false;
+        load();
+        SeatIndex::instance().clear();
+    }
+}
+
+const char* describe(ReservationResult result) {
+    switch (result) {
+        case ReservationResult::Ok: return "Success.";
+        case ReservationResult::NoFlight: return "Flight not found.";
+        case ReservationResult::SoldOut: return "No available tickets for this flight.";
+        case ReservationResult::SeatTaken: return "Seat is already taken on this flight!";
+        case ReservationResult::InvalidSeat: return "Invalid seat number for this flight.";
+        case ReservationResult::DuplicateUser: return "User already has a reservation on this flight!";
+        case ReservationResult::NoReservation: return "User not found!";
+        case ReservationResult::NoBookings: return "User has no reservation.";
+        case ReservationResult::FlightExists: return "Flight with this number already exists!";
+        case ReservationResult::RepeatedFlight: return "An itinerary can't include the same flight twice.";
+        case ReservationResult::AmbiguousBooking: return "User has several reservations; give the flight number.";
+        case ReservationResult::NameMismatch: return "User ID is already registered under a different name.";
+        case ReservationResult::NoAdjacentSeats: return "No adjacent block of seats for the whole group on this flight.";
+        case ReservationResult::Error: break;
+    }
+    return "Database error, nothing was changed.";
+}
+
+// Ticket decrement and Users insert, inside the caller's transaction
+static ReservationResult insertReservation(const User& user) {
+    // Take a ticket only if one is left; no row changed means sold out or no such flight
+    {
+        StatementHandle stmt("UPDATE Flights SET availableTickets = availableTickets - 1 "
+                             "WHERE flightNumber = ? AND availableTickets > 0;");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, user.flightNumber.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) return ReservationResult::Error;
+        if (sqlite3_changes(sqlite3_db_handle(stmt.get())) == 0) {
+            return flightExists(user.flightNumber) ? ReservationResult::SoldOut
+                                                   : ReservationResult::NoFlight;
+        }
+    }
+
+    // First booking for this passenger ID creates the passenger
+    bool created;
+    {
+        StatementHandle stmt("INSERT OR IGNORE INTO Passengers (userID, name) VALUES (?, ?);");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, user.userID.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 2, user.name.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) return ReservationResult::Error;
+        created = sqlite3_changes(sqlite3_db_handle(stmt.get())) == 1;
+    }
+
+    // A returning passenger books under the name on file; no name means "the one on file"
+    if (!created && !user.name.empty()) {
+        StatementHandle stmt("SELECT name FROM Passengers WHERE userID = ?;");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, user.userID.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_ROW) return ReservationResult::Error;
+        if (user.name != reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0))) {
+            return ReservationResult::NameMismatch;
+        }
+    }
+
+    // Claim the seat; the primary key rejects a taken seat, BookingsByPassenger a second
+    // seat for the same passenger on this flight
+    {
+        StatementHandle stmt("INSERT INTO Bookings (flightID, seatNumber, passengerID) VALUES ("
+                             "(SELECT id FROM Flights WHERE flightNumber = ?), ?, "
+                             "(SELECT id FROM Passengers WHERE userID = ?));");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, user.flightNumber.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt.get(), 2, user.seatNumber);
+        sqlite3_bind_text(stmt.get(), 3, user.userID.c_str(), -1, SQLITE_STATIC);
+        int rc = sqlite3_step(stmt.get());
+        if (rc == SQLITE_CONSTRAINT) {
+            return sqlite3_extended_errcode(sqlite3_db_handle(stmt.get())) == SQLITE_CONSTRAINT_PRIMARYKEY
+                       ? ReservationResult::SeatTaken
+                       : ReservationResult::DuplicateUser;
+        }
+        if (rc != SQLITE_DONE) return ReservationResult::Error;
+    }
+
+    return ReservationResult::Ok;
+}
+
+// Claim a seat in memory: the atomic bitmap decides between competing bookers
+ReservationResult claimSeat(const User& user) {
+    shared_ptr<SeatMap> seats = SeatIndex::instance().get(user.flightNumber);
+    if (!seats) return ReservationResult::NoFlight;
+    if (user.seatNumber < 1 || user.seatNumber > seats->capacity()) return ReservationResult::InvalidSeat;
+    return seats->tryClaim(user.seatNumber) ? ReservationResult::Ok : ReservationResult::SeatTaken;
+}
+
+// Store a claimed booking: ticket decrement and Users insert in one transaction
+ReservationResult persistReservation(const User& user) {
+    ReservationResult result = ReservationResult::Error;
+    {
+        Transaction txn;  // BEGIN IMMEDIATE - holds the write lock until commit
+        if (txn.active()) {
+            result = insertReservation(user);
+            if (result == ReservationResult::Ok && !txn.commit()) result = ReservationResult::Error;
+        }
+    }
+
+    if (result == ReservationResult::Ok) {
+        SeatIndex::instance().update(user.flightNumber, user.seatNumber, true);
+    } else if (result != ReservationResult::SeatTaken) {
+        // Give the claim back (a SeatTaken here means another process holds the seat)
+        SeatIndex::instance().update(user.flightNumber, user.seatNumber, false);
+    }
+    return result;
+}
+
+// Claim, then store
+ReservationResult reserveSeat(const User& user) {
+    OperationTimer timer(Metric::ReserveSeat);
+    ReservationResult result = claimSeat(user);
+    return result == ReservationResult::Ok ? persistReservation(user) : result;
+}
+
+int findFreeSeats(const string& flightNumber, int count) {
+    OperationTimer timer(Metric::FindFreeSeats);
+    shared_ptr<SeatMap> seats = SeatIndex::instance().get(flightNumber);
+    return seats ? seats->firstFreeRun(count) : 0;
+}
+
+// Book a group in adjacent seats: every passenger is booked or nobody is
+ReservationResult reserveGroup(vector<User>& passengers) {
+    OperationTimer timer(Metric::ReserveGroup);
+    if (passengers.empty()) return ReservationResult::Ok;
+    const string& flightNumber = passengers.front().flightNumber;
+
+    ReservationResult result = ReservationResult::SeatTaken;
+    for (int attempt = 0; attempt < 3 && result == ReservationResult::SeatTaken; attempt++) {
+        int firstSeat = findFreeSeats(flightNumber, int(passengers.size()));
+        if (firstSeat == 0) {
+            shared_ptr<SeatMap> seats = SeatIndex::instance().get(flightNumber);
+            if (!seats) return ReservationResult::NoFlight;
+            return seats->freeSeatCount() >= int(passengers.size()) ? ReservationResult::NoAdjacentSeats
+                                                                    : ReservationResult::SoldOut;
+        }
+
+        Transaction txn;
+        if (!txn.active()) return ReservationResult::Error;
+        result = ReservationResult::Ok;
+        size_t booked = 0;  // Passengers whose seats are claimed and stored in the savepoint
+        for (; booked < passengers.size(); booked++) {
+            passengers[booked].seatNumber = firstSeat + int(booked);
+            result = reserveSeat(passengers[booked]);  // Nested - a savepoint per passenger
+            if (result != ReservationResult::Ok) break;
+        }
+        if (result == ReservationResult::Ok && txn.commit()) {
+            // Each savepoint recorded its seat before the group was committed; record them
+            // again in case the seat map was reloaded in between
+            for (const User& passenger : passengers) {
+                SeatIndex::instance().update(flightNumber, passenger.seatNumber, true);
+            }
+            return ReservationResult::Ok;
+        }
+
+        // Undo the whole group and give back the seats already claimed for it
+        txn.rollback();
+        for (size_t i = 0; i < booked; i++) {
+            SeatIndex::instance().update(flightNumber, passengers[i].seatNumber, false);
+        }
+        if (result == ReservationResult::Ok) result = ReservationResult::Error;  // Commit failed
+    }
+    return result;
+}
+
+// Book every leg or none: claim seats in flight order, then store all legs in one transaction
+ReservationResult bookItinerary(vector<User>& legs) {
+    OperationTimer timer(Metric::BookItinerary);
+    if (legs.empty()) return ReservationResult::Ok;
+
+    // Fixed claim order across all bookers: by flight number
+    vector<size_t> order(legs.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) { return legs[a].flightNumber < legs[b].flightNumber; });
+    for (size_t i = 1; i < order.size(); i++) {
+        if (legs[order[i]].flightNumber == legs[order[i - 1]].flightNumber) return ReservationResult::RepeatedFlight;
+    }
+
+    auto release = [&](size_t count, size_t keep) {
+        for (size_t i = 0; i < count; i++) {
+            if (i == keep) continue;
+            const User& leg = legs[order[i]];
+            SeatIndex::instance().update(leg.flightNumber, leg.seatNumber, false);
+        }
+    };
+
+    // Claim every seat in memory first; nothing touches the database until all are ours
+    ReservationResult result = ReservationResult::Ok;
+    size_t claimed = 0;
+    for (; claimed < order.size(); claimed++) {
+        User& leg = legs[order[claimed]];
+        if (leg.seatNumber != 0) {
+            result = claimSeat(leg);
+        } else {
+            result = ReservationResult::SeatTaken;
+            for (int attempt = 0; attempt < 3 && result == ReservationResult::SeatTaken; attempt++) {
+                leg.seatNumber = findFreeSeats(leg.flightNumber, 1);
+                if (leg.seatNumber == 0) {
+                    result = SeatIndex::instance().get(leg.flightNumber) ? ReservationResult::SoldOut
+                                                                         : ReservationResult::NoFlight;
+                    break;
+                }
+                result = claimSeat(leg);
+            }
+        }
+        if (result != ReservationResult::Ok) {
+            release(claimed, order.size());
+            return result;
+        }
+    }
+
+    // Store the legs in the same order
+    size_t failed = order.size();  // Leg that the database turned down, if any
+    {
+        Transaction txn;
+        if (!txn.active()) {
+            result = ReservationResult::Error;
+        } else {
+            for (size_t i = 0; i < order.size() && result == ReservationResult::Ok; i++) {
+                result = insertReservation(legs[order[i]]);
+                if (result != ReservationResult::Ok) failed = i;
+            }
+            if (result == ReservationResult::Ok && !txn.commit()) result = ReservationResult::Error;
+        }
+    }
+
+    if (result == ReservationResult::Ok) {
+        // Recorded again now that they are committed, in case a seat map was reloaded meanwhile
+        for (const User& leg : legs) SeatIndex::instance().update(leg.flightNumber, leg.seatNumber, true);
+    } else {
+        // Keep the claim on a seat the database says another process holds
+        release(order.size(), result == ReservationResult::SeatTaken ? failed : order.size());
+    }
+    return result;
+}
+
+// Ticket transfer and Users update, inside the caller's transaction
+static ReservationResult updateReservation(const User& user, const string& oldFlight) {
+    // Moving to another flight takes a ticket there and gives one back on the old flight
+    if (oldFlight != user.flightNumber) {
+        {
+            StatementHandle stmt("UPDATE Flights SET availableTickets = availableTickets - 1 "
+                                 "WHERE flightNumber = ? AND availableTickets > 0;");
+            if (!stmt) return ReservationResult::Error;
+            sqlite3_bind_text(stmt.get(), 1, user.flightNumber.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt.get()) != SQLITE_DONE) return ReservationResult::Error;
+            if (sqlite3_changes(sqlite3_db_handle(stmt.get())) == 0) return ReservationResult::SoldOut;
+        }
+        StatementHandle stmt("UPDATE Flights SET availableTickets = availableTickets + 1 WHERE flightNumber = ?;");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, oldFlight.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) return ReservationResult::Error;
+    }
+
+    {
+        StatementHandle stmt("UPDATE Passengers SET name = ? WHERE userID = ?;");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, user.name.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 2, user.userID.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) return ReservationResult::Error;
+    }
+
+    {
+        StatementHandle stmt("UPDATE Bookings SET flightID = (SELECT id FROM Flights WHERE flightNumber = ?), "
+                             "seatNumber = ? "
+                             "WHERE passengerID = (SELECT id FROM Passengers WHERE userID = ?) "
+                             "AND flightID = (SELECT id FROM Flights WHERE flightNumber = ?);");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, user.flightNumber.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt.get(), 2, user.seatNumber);
+        sqlite3_bind_text(stmt.get(), 3, user.userID.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 4, oldFlight.c_str(), -1, SQLITE_STATIC);
+        int rc = sqlite3_step(stmt.get());
+        if (rc == SQLITE_CONSTRAINT) {
+            // Someone else holds the seat, or the passenger already has a seat on that flight
+            return sqlite3_extended_errcode(sqlite3_db_handle(stmt.get())) == SQLITE_CONSTRAINT_PRIMARYKEY
+                       ? ReservationResult::SeatTaken
+                       : ReservationResult::DuplicateUser;
+        }
+        if (rc != SQLITE_DONE) return ReservationResult::Error;
+    }
+
+    return ReservationResult::Ok;
+}
+
+// A passenger's bookings as (flight number, seat), optionally only the one on a given flight
+static bool findBookings(const string& userID, const string& flightNumber, vector<pair<string, int>>& bookings) {
+    StatementHandle stmt("SELECT f.flightNumber, b.seatNumber FROM Bookings b JOIN Flights f ON f.id = b.flightID "
+                         "WHERE b.passengerID = (SELECT id FROM Passengers WHERE userID = ?) "
+                         "AND (?2 = '' OR f.flightNumber = ?2);");
+    if (!stmt) return false;
+    sqlite3_bind_text(stmt.get(), 1, userID.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 2, flightNumber.c_str(), -1, SQLITE_STATIC);
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        bookings.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0)),
+                              sqlite3_column_int(stmt.get(), 1));
+    }
+    return rc == SQLITE_DONE;
+}
+
+// Move a reservation to another seat and/or flight in one transaction
+ReservationResult modifyBooking(const User& user, const string& fromFlight) {
+    OperationTimer timer(Metric::ModifyBooking);
+    shared_ptr<SeatMap> seats = SeatIndex::instance().get(user.flightNumber);
+    if (!seats) return ReservationResult::NoFlight;
+    if (user.seatNumber < 1 || user.seatNumber > seats->capacity()) return ReservationResult::InvalidSeat;
+
+    Transaction txn;
+    if (!txn.active()) return ReservationResult::Error;
+
+    // Current booking, needed to release the old seat and ticket
+    vector<pair<string, int>> current;
+    if (!findBookings(user.userID, fromFlight, current)) return ReservationResult::Error;
+    if (current.empty()) return userExists(user.userID) ? ReservationResult::NoBookings : ReservationResult::NoReservation;
+    if (current.size() > 1) return ReservationResult::AmbiguousBooking;
+    string oldFlight = current.front().first;
+    int oldSeat = current.front().second;
+
+    // A new seat is claimed in memory first, exactly like a new booking
+    bool moving = oldFlight != user.flightNumber || oldSeat != user.seatNumber;
+    if (moving && !seats->tryClaim(user.seatNumber)) return ReservationResult::SeatTaken;
+
+    ReservationResult result = updateReservation(user, oldFlight);
+    if (result == ReservationResult::Ok && !txn.commit()) result = ReservationResult::Error;
+    if (result != ReservationResult::Ok) {
+        if (moving && result != ReservationResult::SeatTaken) {
+            SeatIndex::instance().update(user.flightNumber, user.seatNumber, false);  // Give the claim back
+        }
+        return result;
+    }
+
+    if (moving) {
+        SeatIndex::instance().update(oldFlight, oldSeat, false);
+        SeatIndex::instance().update(user.flightNumber, user.seatNumber, true);
+    }
+    return ReservationResult::Ok;
+}
+
+// Cancel reservations: seat release and ticket increment in one transaction
+ReservationResult cancelBooking(const string& userID, const string& flightNumber) {
+    OperationTimer timer(Metric::CancelBooking);
+    Transaction txn;
+    if (!txn.active()) return ReservationResult::Error;
+
+    // Find the flights and seats before the rows are deleted
+    vector<pair<string, int>> bookings;
+    if (!findBookings(userID, flightNumber, bookings)) return ReservationResult::Error;
+    if (bookings.empty()) return userExists(userID) ? ReservationResult::NoBookings : ReservationResult::NoReservation;
+
+    for (const auto& booking : bookings) {
+        {
+            StatementHandle stmt("DELETE FROM Bookings WHERE flightID = (SELECT id FROM Flights WHERE flightNumber = ?) "
+                                 "AND seatNumber = ?;");
+            if (!stmt) return ReservationResult::Error;
+            sqlite3_bind_text(stmt.get(), 1, booking.first.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int(stmt.get(), 2, booking.second);
+            if (sqlite3_step(stmt.get()) != SQLITE_DONE) return ReservationResult::Error;
+        }
+        StatementHandle stmt("UPDATE Flights SET availableTickets = availableTickets + 1 WHERE flightNumber = ?;");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, booking.first.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) return ReservationResult::Error;
+    }
+
+    if (!txn.commit()) return ReservationResult::Error;
+    for (const auto& booking : bookings) SeatIndex::instance().update(booking.first, booking.second, false);
+    return ReservationResult::Ok;
+}
+
+// Delete a passenger after cancelling everything they hold
+ReservationResult removePassenger(const string& userID) {
+    OperationTimer timer(Metric::RemovePassenger);
+    if (!userExists(userID)) return ReservationResult::NoReservation;
+
+    Transaction txn;
+    if (!txn.active()) return ReservationResult::Error;
+    ReservationResult result = cancelBooking(userID);  // Nested - a savepoint
+    if (result != ReservationResult::Ok && result != ReservationResult::NoBookings) return result;
+    {
+        StatementHandle stmt("DELETE FROM Passengers WHERE userID = ?;");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, userID.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) return ReservationResult::Error;
+    }
+    if (txn.commit()) return ReservationResult::Ok;
+
+    SeatIndex::instance().clear();  // The cancelled seats were released before the outer commit failed
+    return ReservationResult::Error;
+}
+
+// Add a flight with bound parameters
+ReservationResult insertFlight(const Flight& flight) {
+    OperationTimer timer(Metric::InsertFlight);
+    if (flightExists(flight.flightNumber)) return ReservationResult::FlightExists;
+
+    Transaction txn;  // Commits through afterCommit so the catalog picks the flight up
+    if (!txn.active()) return ReservationResult::Error;
+    {
+        StatementHandle stmt("INSERT INTO Flights (flightNumber, airlineName, startingPoint, destination, "
+                             "totalTickets, availableTickets) VALUES (?, ?, ?, ?, ?, ?);");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, flight.flightNumber.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 2, flight.airlineName.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 3, flight.startingPoint.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 4, flight.destination.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt.get(), 5, flight.totalTickets);
+        sqlite3_bind_int(stmt.get(), 6, flight.availableTickets);
+        int rc = sqlite3_step(stmt.get());
+        if (rc == SQLITE_CONSTRAINT) return ReservationResult::FlightExists;
+        if (rc != SQLITE_DONE) return ReservationResult::Error;
+    }
+    return txn.commit() ? ReservationResult::Ok : ReservationResult::Error;
+}
+
+// Replace a flight's details with bound parameters
+ReservationResult updateFlight(const Flight& flight) {
+    OperationTimer timer(Metric::UpdateFlight);
+    Transaction txn;
+    if (!txn.active()) return ReservationResult::Error;
+    {
+        StatementHandle stmt("UPDATE Flights SET airlineName = ?, startingPoint = ?, destination = ?, "
+                             "totalTickets = ?, availableTickets = ? WHERE flightNumber = ?;");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, flight.airlineName.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 2, flight.startingPoint.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 3, flight.destination.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt.get(), 4, flight.totalTickets);
+        sqlite3_bind_int(stmt.get(), 5, flight.availableTickets);
+        sqlite3_bind_text(stmt.get(), 6, flight.flightNumber.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) return ReservationResult::Error;
+        if (sqlite3_changes(sqlite3_db_handle(stmt.get())) == 0) return ReservationResult::NoFlight;
+    }
+    if (!txn.commit()) return ReservationResult::Error;
+    SeatIndex::instance().invalidate(flight.flightNumber);  // Capacity may have changed
+    return ReservationResult::Ok;
+}
+
+// Delete a flight together with its reservations
+ReservationResult removeFlight(const string& flightNumber) {
+    OperationTimer timer(Metric::RemoveFlight);
+    Transaction txn;
+    if (!txn.active()) return ReservationResult::Error;
+    {
+        StatementHandle stmt("DELETE FROM Bookings WHERE flightID = (SELECT id FROM Flights WHERE flightNumber = ?);");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, flightNumber.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) return ReservationResult::Error;
+    }
+    {
+        StatementHandle stmt("DELETE FROM Flights WHERE flightNumber = ?;");
+        if (!stmt) return ReservationResult::Error;
+        sqlite3_bind_text(stmt.get(), 1, flightNumber.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) return ReservationResult::Error;
+        if (sqlite3_changes(sqlite3_db_handle(stmt.get())) == 0) return ReservationResult::NoFlight;
+    }
+    if (!txn.commit()) return ReservationResult::Error;
+    SeatIndex::instance().invalidate(flightNumber);  // Bookings are gone
+    return ReservationResult::Ok;
+}
+
+BookingQueue& BookingQueue::instance() {
+    ConnectionPool::instance();  // The pool must outlive the writer thread's connection
+    static BookingQueue queue;
+    return queue;
+}
+
+BookingQueue::BookingQueue() : writer(&BookingQueue::run, this) {}
+
+BookingQueue::~BookingQueue() {
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    queued.notify_one();
+    writer.join();  // The writer drains the queue before exiting
+}
+
+future<ReservationResult> BookingQueue::submitReservation(const User& user) {
+    // Settle seat contention in the caller's thread; only winners wait for a commit
+    ReservationResult claim = claimSeat(user);
+    if (claim != ReservationResult::Ok) {
+        promise<ReservationResult> lost;
+        lost.set_value(claim);
+        return lost.get_future();
+    }
+    return submit(Operation{false, user, {}});
+}
+
+future<ReservationResult> BookingQueue::submitCancellation(const string& userID, const string& flightNumber) {
+    User user;
+    user.userID = userID;
+    user.flightNumber = flightNumber;
+    return submit(Operation{true, user, {}});
+}
+
+future<ReservationResult> BookingQueue::submit(Operation op) {
+    future<ReservationResult> result = op.result.get_future();
+    {
+        lock_guard<mutex> lock(mtx);
+        queue.push_back(move(op));
+    }
+    queued.notify_one();
+    return result;
+}
+
+void BookingQueue::run() {
+    TraceRecorder::nameThread("group commit");
+    vector<Operation> group;
+    unique_lock<mutex> lock(mtx);
+    while (true) {
+        queued.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) return;  // Stopping and nothing left to commit
+
+        // Give other callers a short window to join the group
+        auto deadline = chrono::steady_clock::now() + chrono::microseconds(GROUP_COMMIT_WINDOW_US);
+        queued.wait_until(lock, deadline, [this] {
+            return stopping || queue.size() >= GROUP_COMMIT_MAX_OPS;
+        });
+
+        while (!queue.empty() && group.size() < GROUP_COMMIT_MAX_OPS) {
+            group.push_back(move(queue.front()));
+            queue.pop_front();
+        }
+
+        lock.unlock();  // Callers keep queueing while the group is written
+        {
+            OperationTimer timer(Metric::GroupCommit);
+            commitGroup(group);
+        }
+        group.clear();
+        lock.lock();
+    }
+}
+
+void BookingQueue::commitGroup(vector<Operation>& group) {
+    vector<ReservationResult> results(group.size(), ReservationResult::Error);
+    {
+        Transaction txn;  // One commit for the whole group
+        if (txn.active()) {
+            for (size_t i = 0; i < group.size(); i++) {
+                // Each operation nests as a savepoint, so a failure only undoes itself
+                results[i] = group[i].cancel ? cancelBooking(group[i].user.userID, group[i].user.flightNumber)
+                                             : persistReservation(group[i].user);
+            }
+            if (!txn.commit()) {
+                results.assign(group.size(), ReservationResult::Error);  // Nothing was stored
+                // Seat maps were updated as each savepoint was released; reload them
+                SeatIndex::instance().clear();
+            }
+        }
+    }
+
+    for (size_t i = 0; i < group.size(); i++) {
+        group[i].result.set_value(results[i]);
+    }
+}
+
+// Add a new flight to the database
+void addFlight() {
+    Flight flight;  // Flight object to store new data
+    cout << "\nEnter Flight Number: ";
+    getline(cin, flight.flightNumber);  // Get flight number from user
+    
+    // Check if flight already exists
+    if (flightExists(flight.flightNumber)) {
+        cout << "Flight with this number already exists!\n";
+        return;
+    }
+
+    // Get remaining flight details from user
+    cout << "Enter Airline Name: ";
+    getline(cin, flight.airlineName);
+    cout << "Enter Starting Point: ";
+    getline(cin, flight.startingPoint);
+    cout << "Enter Destination: ";
+    getline(cin, flight.destination);
+    cout << "Enter Total Tickets: ";
+    cin >> flight.totalTickets;
+    flight.availableTickets = flight.totalTickets;  // Set available tickets equal to total
+    cin.ignore();  // Clear input buffer
+
+    // Store the flight with bound parameters
+    ReservationResult result = insertFlight(flight);
+    if (result != ReservationResult::Ok) {
+        cout << describe(result) << "\n";
+    } else {
+        cout << "Flight added successfully.\n";
+    }
+}
+
+// Modify an existing flight
+void modifyFlight() {
+    string flightNumber;  // Flight number to modify
+    cout << "\nEnter Flight Number to modify: ";
+    getline(cin, flightNumber);
+
+    // Check if flight exists
+    if (!flightExists(flightNumber)) {
+        cout << "Flight not found!\n";
+        return;
+    }
+
+    Flight flight;  // Flight object for new data
+    flight.flightNumber = flightNumber;
+    // Get new flight details from user
+    cout << "Enter New Airline Name: ";
+    getline(cin, flight.airlineName);
+    cout << "Enter New Starting Point: ";
+    getline(cin, flight.startingPoint);
+    cout << "Enter New Destination: ";
+    getline(cin, flight.destination);
+    cout << "Enter New Total Tickets: ";
+    cin >> flight.totalTickets;
+    cout << "Enter New Available Tickets: ";
+    cin >> flight.availableTickets;
+    cin.ignore(); // Clear input buffer
+
+    // Store the new details with bound parameters
+    ReservationResult result = updateFlight(flight);
+    if (result != ReservationResult::Ok) {
+        cout << describe(result) << "\n";
+    } else {
+        cout << "Flight modified successfully.\n";
+    }
+}
+
+// Delete a flight from the database
+void deleteFlight() {
+    string flightNumber;  // Flight number to delete
+    cout << "\nEnter Flight Number to delete: ";
+    getline(cin, flightNumber);
+
+    // Check if flight exists
+    if (!flightExists(flightNumber)) {
+        cout << "Flight not found!\n";
+        return;
+    }
+
+    // Delete the flight and all users associated with it in one transaction
+    ReservationResult result = removeFlight(flightNumber);
+    if (result != ReservationResult::Ok) {
+        cout << describe(result) << "\n";
+    } else {
+        cout << "Flight and associated users deleted successfully.\n";
+    }
+}
+
+// Submit a booking to the group-commit queue
+// A seat number of 0 asks for the lowest free seat, chosen again if another agent takes it first
+static ReservationResult submitBooking(User& user) {
+    if (user.seatNumber != 0) {
+        return BookingQueue::instance().submitReservation(user).get();
+    }
+    ReservationResult result = ReservationResult::SeatTaken;
+    for (int attempt = 0; attempt < 3 && result == ReservationResult::SeatTaken; attempt++) {
+        user.seatNumber = findFreeSeats(user.flightNumber, 1);
+        if (user.seatNumber == 0) return ReservationResult::SoldOut;
+        result = BookingQueue::instance().submitReservation(user).get();
+    }
+    return result;
+}
+
+// Add a new user to the database
+void addUser() {
+    User user;  // User object for new data
+    cout << "\nEnter User ID: ";
+    getline(cin, user.userID);
+    
+    // Check if user already exists
+    if (userExists(user.userID)) {
+        cout << "User with this ID already exists!\n";
+        return;
+    }
+
+    // Get user details from input
+    cout << "Enter Name: ";
+    getline(cin, user.name);
+    cout << "Enter Flight Number: ";
+    getline(cin, user.flightNumber);
+    
+    // Check if flight exists
+    if (!flightExists(user.flightNumber)) {
+        cout << "Flight doesn't exist!\n";
+        return;
+    }
+
+    // Get and display taken seats
+    vector<int> takenSeats = getTakenSeats(user.flightNumber);
+    cout << "Taken seats: ";
+    for (int seat : takenSeats) {
+        cout << seat << " ";
+    }
+    cout << "\nEnter Seat Number (0 for automatic assignment): ";
+    cin >> user.seatNumber;
+    cin.ignore(); // Clear input buffer
+
+    // Check if seat is available
+    if (user.seatNumber != 0 && !isSeatAvailable(user.flightNumber, user.seatNumber)) {
+        cout << "Seat " << user.seatNumber << " is already taken on this flight!\n";
+        return;
+    }
+
+    // Insert the user and take the ticket, committed together with other queued bookings
+    ReservationResult result = submitBooking(user);
+    if (result == ReservationResult::Ok) {
+        cout << "User added successfully in seat " << user.seatNumber << ".\n";
+    } else {
+        cout << describe(result) << "\n";
+    }
+}
+
+// Modify an existing user
+void modifyUser() {
+    string userID;  // User ID to modify
+    cout << "\nEnter User ID to modify: ";
+    getline(cin, userID);
+
+    // Check if user exists
+    if (!userExists(userID)) {
+        cout << "User not found!\n";
+        return;
+    }
+
+    // A passenger with several bookings says which one to move
+    string fromFlight;
+    vector<pair<string, int>> bookings;
+    findBookings(userID, "", bookings);
+    if (bookings.size() > 1) {
+        cout << "Enter Current Flight Number of the reservation to change: ";
+        getline(cin, fromFlight);
+    }
+
+    User user;  // User object for new data
+    user.userID = userID;
+    // Get new user details from input
+    cout << "Enter New Name: ";
+    getline(cin, user.name);
+    cout << "Enter New Flight Number: ";
+    getline(cin, user.flightNumber);
+    
+    // Check if new flight exists
+    if (!flightExists(user.flightNumber)) {
+        cout << "Flight doesn't exist!\n";
+        return;
+    }
+
+    cout << "Enter New Seat Number: ";
+    cin >> user.seatNumber;
+    cin.ignore(); // Clear input buffer
+
+    // Move the seat (and ticket, if the flight changed) in one transaction
+    ReservationResult result = modifyBooking(user, fromFlight);
+    if (result == ReservationResult::Ok) {
+        cout << "User modified successfully.\n";
+    } else if (result == ReservationResult::SeatTaken) {
+        cout << "Seat " << user.seatNumber << " is already taken on this flight!\n";
+    } else {
+        cout << describe(result) << "\n";
+    }
+}
+
+// Delete a user from the database
+void deleteUser() {
+    string userID;  // User ID to delete
+    cout << "\nEnter User ID to delete: ";
+    getline(cin, userID);
+
+    // Check if user exists
+    if (!userExists(userID)) {
+        cout << "User not found!\n";
+        return;
+    }
+
+    // Cancel the bookings, returning their seats, and delete the passenger
+    ReservationResult result = removePassenger(userID);
+    if (result == ReservationResult::Ok) {
+        cout << "User deleted successfully.\n";
+    } else {
+        cout << describe(result) << "\n";
+    }
+}
+
+// Make a flight reservation
+void makeReservation() {
+    string userID, flightNumber;
+    cout << "\nEnter User ID: ";
+    getline(cin, userID);
+
+    // An existing passenger books another flight under the name already on file
+    bool returning = userExists(userID);
+    if (returning) cout << "Existing passenger - adding a reservation.\n";
+
+    cout << "Enter Flight Number: ";
+    getline(cin, flightNumber);
+
+    // Check available tickets
+    int availableTickets = -1;
+    Flight flight;
+    if (FlightCatalog::instance().find(flightNumber, flight)) {  // Cached, no SQL
+        availableTickets = flight.availableTickets;
+    }
+
+    if (availableTickets == -1) {
+        cout << "Flight not found.\n";
+        return;
+    }
+
+    if (availableTickets <= 0) {
+        cout << "No available tickets for this flight.\n";
+        return;
+    }
+
+    // Show taken seats
+    vector<int> takenSeats = getTakenSeats(flightNumber);
+    cout << "Taken seats: ";
+    for (int seat : takenSeats) {
+        cout << seat << " ";
+    }
+    cout << endl;
+
+    User user;
+    user.userID = userID;
+    if (!returning) {
+        cout << "Enter Name: ";
+        getline(cin, user.name);
+    }
+    user.flightNumber = flightNumber;
+    cout << "Enter Seat Number (0 for automatic assignment): ";
+    cin >> user.seatNumber;
+    cin.ignore(); // Clear input buffer
+
+    // Check if seat is available
+    if (user.seatNumber != 0 && !isSeatAvailable(flightNumber, user.seatNumber)) {
+        cout << "Seat " << user.seatNumber << " is already taken on this flight!\n";
+        return;
+    }
+
+    // Recheck availability, claim the seat and take the ticket in the next group commit
+    ReservationResult result = submitBooking(user);
+    if (result == ReservationResult::Ok) {
+        cout << "Reservation successful! Seat " << user.seatNumber << " booked.\n";
+    } else {
+        cout << describe(result) << "\n";
+    }
+}
+
+// Book a group of passengers in adjacent seats
+void makeGroupReservation() {
+    string flightNumber;
+    cout << "\nEnter Flight Number: ";
+    getline(cin, flightNumber);
+
+    if (!flightExists(flightNumber)) {
+        cout << "Flight not found.\n";
+        return;
+    }
+
+    int groupSize = 0;
+    cout << "Enter Number of Passengers: ";
+    cin >> groupSize;
+    cin.ignore(); // Clear input buffer
+    if (groupSize < 1) {
+        cout << "Invalid number of passengers.\n";
+        return;
+    }
+
+    // Collect every passenger before booking anything
+    vector<User> passengers(groupSize);
+    for (int i = 0; i < groupSize; i++) {
+        cout << "Passenger " << i + 1 << " User ID: ";
+        getline(cin, passengers[i].userID);
+        cout << "Passenger " << i + 1 << " Name: ";
+        getline(cin, passengers[i].name);
+        passengers[i].flightNumber = flightNumber;
+    }
+
+    ReservationResult result = reserveGroup(passengers);
+    if (result == ReservationResult::Ok) {
+        cout << "Group reservation successful! Seats " << passengers.front().seatNumber
+             << "-" << passengers.back().seatNumber << " booked.\n";
+    } else if (result == ReservationResult::NoAdjacentSeats) {
+        cout << "No adjacent block of " << groupSize << " seats on this flight.\n";
+    } else {
+        cout << describe(result) << "\n";
+    }
+}
+
+// Book a passenger on several flights in one go
+void makeItineraryReservation() {
+    string userID, name;
+    cout << "\nEnter User ID: ";
+    getline(cin, userID);
+    cout << "Enter Name: ";
+    getline(cin, name);
+
+    int legCount;
+    cout << "Enter Number of Flights: ";
+    cin >> legCount;
+    cin.ignore();
+    if (legCount < 1) {
+        cout << "An itinerary needs at least one flight.\n";
+        return;
+    }
+
+    vector<User> legs;
+    for (int i = 1; i <= legCount; i++) {
+        User leg{name, userID, "", 0};
+        cout << "Flight " << i << " - Flight Number: ";
+        getline(cin, leg.flightNumber);
+        cout << "Flight " << i << " - Seat Number (0 for automatic assignment): ";
+        cin >> leg.seatNumber;
+        cin.ignore();
+        legs.push_back(leg);
+    }
+
+    ReservationResult result = bookItinerary(legs);
+    if (result != ReservationResult::Ok) {
+        cout << describe(result) << " No flights were booked.\n";
+        return;
+    }
+    cout << "Itinerary booked:\n";
+    for (const User& leg : legs) {
+        cout << "  " << leg.userID << ": flight " << leg.flightNumber << ", seat " << leg.seatNumber << "\n";
+    }
+}
+
+// Cancel a reservation
+void cancelReservation() {
+    string userID;
+    cout << "\nEnter User ID to cancel reservation: ";
     getline(cin, userID);
 
-    // Check if user exists
-    if (!userExists(userID)) {
-        cout << "User not found!\n";
-        return;
+    // Check if user exists
+    if (!userExists(userID)) {
+        cout << "User not found!\n";
+        return;
+    }
+
+    // A passenger with several bookings may cancel just one of them
+    string flightNumber;
+    vector<pair<string, int>> bookings;
+    findBookings(userID, "", bookings);
+    if (bookings.size() > 1) {
+        cout << "Enter Flight Number to cancel (blank for all " << bookings.size() << " reservations): ";
+        getline(cin, flightNumber);
+    }
+
+    // Delete the bookings and return the seats to their flights in the next group commit
+    ReservationResult result = BookingQueue::instance().submitCancellation(userID, flightNumber).get();
+    if (result == ReservationResult::Ok) {
+        cout << "Reservation canceled successfully.\n";
+    } else {
+        cout << describe(result) << "\n";
+    }
+}
+
+// Read one page of rows whose key follows after; asks for one extra row to learn if more follow
+template <typename Row, typename... Ts>
+static bool readPage(const RowMapper<Row, Ts...>& mapper, const char* table, const char* key,
+                     string Row::*keyMember, const string& after, size_t limit, Page<Row>& page) {
+    page.rows.clear();
+    page.more = false;
+    StatementHandle stmt("SELECT " + mapper.selectList() + " FROM " + table + " WHERE " + key +
+                         " > ? ORDER BY " + key + " LIMIT ?;");
+    if (!stmt) return false;
+    sqlite3_bind_text(stmt.get(), 1, after.c_str(), -1, SQLITE_STATIC);  // "" sorts before every key
+    sqlite3_bind_int64(stmt.get(), 2, sqlite3_int64(limit) + 1);
+
+    bool ok = mapper.forEach(stmt.get(), [&](Row& row) {
+        if (page.rows.size() == limit) page.more = true;
+        else page.rows.push_back(move(row));
+    });
+    if (!ok) {
+        cerr << "SQL error: " << sqlite3_errmsg(sqlite3_db_handle(stmt.get())) << endl;
+        return false;
+    }
+    if (!page.rows.empty()) page.nextAfter = page.rows.back().*keyMember;
+    return true;
+}
+
+// List flights after a flight number
+bool listFlights(const string& after, size_t limit, Page<Flight>& page) {
+    OperationTimer timer(Metric::ListFlights);
+    return readPage(FLIGHT_ROW, "Flights", "flightNumber", &Flight::flightNumber, after, limit, page);
+}
+
+// List passengers after a user ID, each with all of their bookings
+bool listUsers(const string& after, size_t limit, Page<User>& page) {
+    OperationTimer timer(Metric::ListUsers);
+    page.rows.clear();
+    page.more = false;
+    // Page over Passengers by its userID index; the bookings of each come along by join
+    StatementHandle stmt("SELECT p.userID AS userID, p.name AS name, f.flightNumber AS flightNumber, "
+                         "b.seatNumber AS seatNumber "
+                         "FROM (SELECT id, userID, name FROM Passengers WHERE userID > ? ORDER BY userID LIMIT ?) p "
+                         "LEFT JOIN Bookings b ON b.passengerID = p.id LEFT JOIN Flights f ON f.id = b.flightID "
+                         "ORDER BY p.userID, f.flightNumber;");
+    if (!stmt) return false;
+    sqlite3_bind_text(stmt.get(), 1, after.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt.get(), 2, sqlite3_int64(limit) + 1);  // One extra to learn if more follow
+
+    size_t passengers = 0;
+    string lastID;
+    bool ok = USER_ROW.forEach(stmt.get(), [&](User& user) {
+        if (passengers == 0 || user.userID != lastID) {
+            passengers++;
+            lastID = user.userID;
+        }
+        if (passengers > limit) page.more = true;
+        else page.rows.push_back(move(user));
+    });
+    if (!ok) {
+        cerr << "SQL error: " << sqlite3_errmsg(sqlite3_db_handle(stmt.get())) << endl;
+        return false;
+    }
+    if (!page.rows.empty()) page.nextAfter = page.rows.back().userID;
+    return true;
+}
+
+// Route search with * as a prefix marker
+bool searchRoutes(const string& from, const string& to, vector<Flight>& found) {
+    OperationTimer timer(Metric::SearchRoutes);
+    auto city = [](const string& text, bool& prefix) {
+        prefix = !text.empty() && text.back() == '*';
+        return prefix ? text.substr(0, text.size() - 1) : text;
+    };
+    bool fromPrefix, toPrefix;
+    string origin = city(from, fromPrefix), destination = city(to, toPrefix);
+    return FlightCatalog::instance().searchRoutes(origin, fromPrefix, destination, toPrefix, found);
+}
+
+// Ask whether to show the next page of a listing
+static bool morePages() {
+    cout << "-- Press Enter for more, q to stop -- ";
+    string answer;
+    if (!getline(cin, answer)) return false;
+    return answer.empty() || (answer[0] != 'q' && answer[0] != 'Q');
+}
+
+// Display all flights
+void displayFlights() {
+    cout << "\n--- Flight Information ---\n";
+    Page<Flight> page;
+    do {
+        if (!listFlights(page.nextAfter, LIST_PAGE_SIZE, page)) return;
+        for (const Flight& flight : page.rows) {
+            flight.display();
+            cout << "----------------------------------------\n";  // Separator
+        }
+    } while (page.more && morePages());
+}
+
+// Display all users
+void displayUsers() {
+    cout << "\n--- User Information ---\n";
+    Page<User> page;
+    do {
+        if (!listUsers(page.nextAfter, LIST_PAGE_SIZE, page)) return;
+        for (const User& user : page.rows) {
+            user.display();
+            cout << "----------------------------------------\n";  // Separator
+        }
+    } while (page.more && morePages());
+}
+
+// Display storage settings and runtime counters
+void displayStorageStats() {
+    StorageStats storage = CheckpointManager::instance().stats();
+    StatementCacheStats statements = ConnectionPool::instance().statementStats();
+
+    cout << "\n--- Storage Statistics ---\n";
+    cout << left << setw(26) << "Journal Mode:" << storageConfig.journalMode << "\n";
+    cout << setw(26) << "Synchronous:" << storageConfig.synchronous << "\n";
+    cout << setw(26) << "Cache Size (KiB):" << storageConfig.cacheSizeKiB << "\n";
+    cout << setw(26) << "Mmap Size (bytes):" << storageConfig.mmapSizeBytes << "\n";
+    cout << setw(26) << "Commits:" << storage.commits << "\n";
+    cout << setw(26) << "WAL Frames:" << storage.walFrames << "\n";
+    cout << setw(26) << "Passive Checkpoints:" << storage.passiveCheckpoints << "\n";
+    cout << setw(26) << "Truncate Checkpoints:" << storage.truncateCheckpoints << "\n";
+    cout << setw(26) << "Frames Checkpointed:" << storage.framesCheckpointed << "\n";
+    cout << setw(26) << "Incomplete Checkpoints:" << storage.busyCheckpoints << "\n";
+    cout << setw(26) << "Cached Flights:" << FlightCatalog::instance().size() << "\n";
+    cout << setw(26) << "Catalog Reloads:" << FlightCatalog::instance().reloads() << "\n";
+    cout << setw(26) << "Statement Cache Hits:" << statements.hits << "\n";
+    cout << setw(26) << "Statement Cache Misses:" << statements.misses << "\n";
+    cout << setw(26) << "Statement Evictions:" << statements.evictions << "\n";
+}
+
+// Display latency percentiles and SQL work per operation
+void displayOperationStats() {
+    vector<HistogramSnapshot> metrics;
+    uint64_t statements, rows;
+    MetricsRegistry::instance().snapshot(metrics, statements, rows);
+
+    auto micros = [](uint64_t nanos) { return nanos / 1000.0; };
+    cout << "\n--- Operation Statistics (latency in microseconds) ---\n";
+    cout << left << setw(17) << "Operation" << right << setw(10) << "Count" << setw(10) << "Mean"
+         << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "p99.9"
+         << setw(11) << "Max" << setw(10) << "Stmts/op" << setw(10) << "Rows/op" << "\n";
+    cout << fixed << setprecision(1);
+    for (int i = 0; i < static_cast<int>(Metric::Count); i++) {
+        const HistogramSnapshot& metric = metrics[i];
+        if (metric.count == 0) continue;
+        cout << left << setw(17) << METRIC_NAMES[i] << right << setw(10) << metric.count
+             << setw(10) << micros(metric.totalNanos) / metric.count << setw(10) << micros(metric.percentile(0.5))
+             << setw(10) << micros(metric.percentile(0.9)) << setw(10) << micros(metric.percentile(0.99))
+             << setw(10) << micros(metric.percentile(0.999)) << setw(11) << micros(metric.maxNanos)
+             << setw(10) << double(metric.statements) / metric.count << setw(10) << double(metric.rows) / metric.count
+             << "\n";
+    }
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+    cout << left << setw(26) << "SQL Statements Executed:" << statements << "\n";
+    cout << setw(26) << "Rows Read:" << rows << "\n";
+}
+
+// Display the SQL profile, most total time first
+void displaySqlProfile() {
+    if (!SqlProfiler::active()) {
+        cout << "SQL profiling is off; start the program with --profile <slow-query ms>.\n";
+        return;
+    }
+    vector<StatementProfile> profiles;
+    SqlProfiler::instance().snapshot(profiles);
+
+    cout << "\n--- SQL Profile (most total time first) ---\n";
+    cout << right << setw(9) << "Count" << setw(11) << "Total ms" << setw(10) << "Mean us" << setw(10) << "Max us"
+         << setw(10) << "Rows" << setw(12) << "Scan steps" << "  Statement\n";
+    cout << fixed;
+    for (const StatementProfile& profile : profiles) {
+        string sql = profile.sql.size() > 70 ? profile.sql.substr(0, 67) + "..." : profile.sql;
+        cout << setw(9) << profile.count << setprecision(2) << setw(11) << profile.totalNanos / 1e6
+             << setprecision(1) << setw(10) << profile.totalNanos / 1e3 / profile.count
+             << setw(10) << profile.maxNanos / 1e3 << setw(10) << profile.rows << setw(12) << profile.scanSteps
+             << "  " << sql << "\n";
+    }
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+    cout << left << setw(26) << "Slow Queries Logged:" << SqlProfiler::instance().slowCount()
+         << " (" << SqlProfiler::instance().logPath() << ")\n" << right;
+}
+
+// Split a batch command line into arguments
+// Arguments are separated by whitespace; double quotes group words and \" escapes a quote
+static bool splitCommand(const string& line, vector<string>& args, string& error) {
+    args.clear();
+    size_t i = 0;
+    while (i < line.size()) {
+        if (isspace(static_cast<unsigned char>(line[i]))) { i++; continue; }
+        if (line[i] == '#') break;  // Comment runs to the end of the line
+
+        string arg;
+        if (line[i] == '"') {
+            i++;
+            while (i < line.size() && line[i] != '"') {
+                if (line[i] == '\\' && i + 1 < line.size()) i++;  // Escaped character
+                arg += line[i++];
+            }
+            if (i == line.size()) {
+                error = "unterminated quote";
+                return false;
+            }
+            i++;  // Closing quote
+        } else {
+            while (i < line.size() && !isspace(static_cast<unsigned char>(line[i]))) arg += line[i++];
+        }
+        args.push_back(arg);
+    }
+    return true;
+}
+
+// Parse a whole-number argument
+static bool parseNumber(const string& text, int& value) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (*end != '\0' || parsed < INT32_MIN || parsed > INT32_MAX) return false;
+    value = int(parsed);
+    return true;
+}
+
+// Run one batch command; detail receives the message printed after ok/error
+static bool runBatchCommand(const vector<string>& args, string& detail) {
+    const string& command = args[0];
+    size_t argCount = args.size() - 1;
+    ReservationResult result = ReservationResult::Error;
+
+    if (command == "add-flight" && argCount == 5) {
+        Flight flight{args[1], args[2], args[3], args[4], 0, 0};
+        if (!parseNumber(args[5], flight.totalTickets)) { detail = "invalid ticket count"; return false; }
+        flight.availableTickets = flight.totalTickets;
+        result = insertFlight(flight);
+    } else if (command == "modify-flight" && argCount == 6) {
+        Flight flight{args[1], args[2], args[3], args[4], 0, 0};
+        if (!parseNumber(args[5], flight.totalTickets) || !parseNumber(args[6], flight.availableTickets)) {
+            detail = "invalid ticket count";
+            return false;
+        }
+        result = updateFlight(flight);
+    } else if (command == "delete-flight" && argCount == 1) {
+        result = removeFlight(args[1]);
+    } else if ((command == "book" && argCount == 4) || (command == "modify" && (argCount == 4 || argCount == 5))) {
+        User user{args[2], args[1], args[3], 0};
+        if (command == "book" && args[4] == "auto") {
+            user.seatNumber = findFreeSeats(user.flightNumber, 1);
+            if (user.seatNumber == 0) {
+                result = flightExists(user.flightNumber) ? ReservationResult::SoldOut : ReservationResult::NoFlight;
+                detail = describe(result);
+                return false;
+            }
+        } else if (!parseNumber(args[4], user.seatNumber)) {
+            detail = "invalid seat number";
+            return false;
+        }
+        result = command == "book" ? reserveSeat(user) : modifyBooking(user, argCount == 5 ? args[5] : "");
+        if (result == ReservationResult::Ok) detail = "seat " + to_string(user.seatNumber);
+    } else if (command == "cancel" && (argCount == 1 || argCount == 2)) {
+        result = cancelBooking(args[1], argCount == 2 ? args[2] : "");
+    } else if (command == "delete-user" && argCount == 1) {
+        result = removePassenger(args[1]);
+    } else if (command == "group" && argCount >= 3 && argCount % 2 == 1) {
+        vector<User> passengers;
+        for (size_t i = 2; i + 1 < args.size(); i += 2) {
+            passengers.push_back(User{args[i + 1], args[i], args[1], 0});
+        }
+        result = reserveGroup(passengers);
+        if (result == ReservationResult::Ok) {
+            detail = "seats " + to_string(passengers.front().seatNumber) + "-" +
+                     to_string(passengers.back().seatNumber);
+        } else if (result == ReservationResult::NoAdjacentSeats) {
+            detail = "no adjacent block of " + to_string(passengers.size()) + " seats";
+            return false;
+        }
+    } else if (command == "routes" && (argCount == 1 || argCount == 2)) {
+        vector<Flight> found;
+        if (!searchRoutes(args[1], argCount == 2 ? args[2] : "", found)) return false;
+        for (const Flight& flight : found) {
+            flight.display();
+            cout << "----------------------------------------\n";
+        }
+        detail = to_string(found.size()) + " flight(s)";
+        return true;
+    } else if (command == "itinerary" && argCount >= 3) {
+        vector<User> legs;
+        for (size_t i = 3; i < args.size(); i++) {
+            // <flight> or <flight>:<seat>
+            User leg{args[2], args[1], args[i], 0};
+            size_t colon = args[i].rfind(':');
+            if (colon != string::npos) {
+                leg.flightNumber = args[i].substr(0, colon);
+                if (!parseNumber(args[i].substr(colon + 1), leg.seatNumber)) {
+                    detail = "invalid seat number";
+                    return false;
+                }
+            }
+            legs.push_back(leg);
+        }
+        result = bookItinerary(legs);
+        if (result == ReservationResult::Ok) {
+            for (const User& leg : legs) {
+                detail += (detail.empty() ? "" : " ") + leg.userID + "=" + leg.flightNumber + ":" +
+                          to_string(leg.seatNumber);
+            }
+        }
+    } else if (command == "connections" && (argCount == 2 || argCount == 3)) {
+        int maxLegs = CONNECTION_MAX_LEGS;
+        if (argCount == 3 && (!parseNumber(args[3], maxLegs) || maxLegs < 1)) {
+            detail = "invalid leg limit";
+            return false;
+        }
+        vector<vector<Flight>> itineraries;
+        if (!FlightCatalog::instance().findConnections(args[1], args[2], maxLegs, CONNECTION_MAX_RESULTS,
+                                                       itineraries)) {
+            return false;
+        }
+        for (const vector<Flight>& legs : itineraries) {
+            for (size_t i = 0; i < legs.size(); i++) {
+                cout << (i ? " -> " : "") << legs[i].flightNumber << " (" << legs[i].startingPoint << "-"
+                     << legs[i].destination << ", " << legs[i].availableTickets << " left)";
+            }
+            cout << "\n";
+        }
+        detail = to_string(itineraries.size()) + " itinerary(s)";
+        return true;
+    } else if (command == "stats" && argCount == 0) {
+        displayOperationStats();
+        return true;
+    } else if (command == "profile" && argCount == 0) {
+        displaySqlProfile();
+        return true;
+    } else if (command == "seats" && argCount == 1) {
+        if (!flightExists(args[1])) { detail = describe(ReservationResult::NoFlight); return false; }
+        for (int seat : getTakenSeats(args[1])) detail += (detail.empty() ? "" : " ") + to_string(seat);
+        return true;
+    } else if (command == "export" && argCount >= 3) {
+        if (runExport(vector<string>(args.begin() + 1, args.end())) != 0) {
+            detail = "export failed";
+            return false;
+        }
+        return true;
+    } else if ((command == "list-flights" || command == "list-users") && argCount <= 2) {
+        // No limit lists everything, a page at a time; otherwise one page after the given key
+        int limit = 0;
+        if (argCount >= 1 && (!parseNumber(args[1], limit) || limit < 1)) {
+            detail = "invalid page size";
+            return false;
+        }
+        string after = argCount == 2 ? args[2] : "";
+        bool more;
+        do {
+            if (command == "list-flights") {
+                Page<Flight> page;
+                if (!listFlights(after, limit ? limit : LIST_PAGE_SIZE, page)) return false;
+                for (const Flight& flight : page.rows) {
+                    flight.display();
+                    cout << "----------------------------------------\n";
+                }
+                more = page.more;
+                after = page.nextAfter;
+            } else {
+                Page<User> page;
+                if (!listUsers(after, limit ? limit : LIST_PAGE_SIZE, page)) return false;
+                for (const User& user : page.rows) {
+                    user.display();
+                    cout << "----------------------------------------\n";
+                }
+                more = page.more;
+                after = page.nextAfter;
+            }
+        } while (more && limit == 0);
+        if (more) detail = "next " + after;
+        return true;
+    } else {
+        detail = "unknown command or wrong number of arguments";
+        return false;
+    }
+
+    if (result != ReservationResult::Ok) detail = describe(result);
+    return result == ReservationResult::Ok;
+}
+
+// @return: Whether a batch command only reads, so it runs outside the group transaction
+static bool isReadOnlyCommand(const string& command) {
+    static const set<string> readOnly = {"seats", "routes", "connections", "list-flights",
+                                         "list-users", "stats", "profile", "export"};
+    return readOnly.count(command) > 0;
+}
+
+// Run a command file through the same operations as the menu
+int runBatch(const string& path) {
+    ifstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file) {
+            cerr << "Can't open batch file: " << path << endl;
+            return 1;
+        }
+    }
+    istream& input = path == "-" ? cin : file;
+
+    auto start = chrono::steady_clock::now();
+    size_t lineNumber = 0, commands = 0, succeeded = 0;
+    vector<string> args;
+    string line, detail;
+
+    // Changes are committed in large groups; each command nests as its own savepoint. Status
+    // lines wait in pending until their group commits, so a rolled-back group never shows ok.
+    struct LineResult {
+        size_t lineNumber;
+        bool ok;
+        string detail;
+    };
+    vector<LineResult> pending;
+    auto print = [](const LineResult& result) {
+        cout << "line " << result.lineNumber << ": " << (result.ok ? "ok" : "error")
+             << (result.detail.empty() ? "" : " ") << result.detail << "\n";
+    };
+    unique_ptr<Transaction> txn;
+    int inTransaction = 0;
+    auto commitGroup = [&]() {
+        bool committed = !txn || txn->commit();
+        if (!committed) {
+            cerr << "Batch commit failed near line " << lineNumber << "; " << inTransaction
+                 << " command(s) rolled back\n";
+            SeatIndex::instance().clear();  // Seat maps were updated as each command ran
+        }
+        for (LineResult& result : pending) {
+            if (!committed && result.ok) {
+                result.ok = false;
+                result.detail = "rolled back: batch commit failed";
+                succeeded--;
+            }
+            print(result);
+        }
+        pending.clear();
+        txn.reset();
+        inTransaction = 0;
+    };
+
+    while (getline(input, line)) {
+        lineNumber++;
+        if (!splitCommand(line, args, detail)) {
+            commands++;
+            pending.push_back(LineResult{lineNumber, false, detail});
+            continue;
+        }
+        if (args.empty()) continue;  // Blank line or comment
+
+        TraceSpan span(args[0], line);
+        commands++;
+        detail.clear();
+        if (isReadOnlyCommand(args[0])) {
+            // Sees every earlier change, without holding the write lock while it reads
+            commitGroup();
+            bool ok = runBatchCommand(args, detail);
+            if (ok) succeeded++;
+            print(LineResult{lineNumber, ok, detail});
+            continue;
+        }
+        if (!txn) txn = make_unique<Transaction>();
+        inTransaction++;
+        bool ok = runBatchCommand(args, detail);
+        if (ok) succeeded++;
+        pending.push_back(LineResult{lineNumber, ok, detail});
+        if (inTransaction >= BATCH_TRANSACTION_SIZE) commitGroup();
+    }
+    commitGroup();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "\n--- Batch Summary ---\n";
+    cout << left << setw(20) << "Commands:" << commands << "\n";
+    cout << setw(20) << "Succeeded:" << succeeded << "\n";
+    cout << setw(20) << "Failed:" << commands - succeeded << "\n";
+    cout << setw(20) << "Elapsed (s):" << fixed << setprecision(3) << seconds << "\n";
+    cout << setw(20) << "Commands/s:" << setprecision(0) << (seconds > 0 ? commands / seconds : 0) << "\n";
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+    return succeeded == commands ? 0 : 1;
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) munmap(const_cast<char*>(bytes), length);
+}
+
+bool MappedFile::open(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0;
+    if (ok && info.st_size > 0) {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ok = false;
+        } else {
+            madvise(mapping, info.st_size, MADV_SEQUENTIAL);  // Read once, front to back
+            bytes = static_cast<const char*>(mapping);
+            length = info.st_size;
+        }
+    }
+    close(fd);  // The mapping stays valid without the descriptor
+    return ok;
+}
+
+bool CsvReader::next(vector<string_view>& fields) {
+    fields.clear();
+    unescaped.clear();
+    errorText.clear();
+
+    // Skip blank lines
+    while (pos < end && (*pos == '\n' || *pos == '\r')) {
+        if (*pos == '\n') nextLine++;
+        pos++;
+    }
+    if (pos == end) return false;
+
+    const char* start = pos;
+    recordLine = nextLine;
+    while (true) {
+        if (*pos == '"') {
+            // Quoted field: runs to the next quote that isn't doubled
+            const char* fieldStart = ++pos;
+            bool doubled = false;
+            while (true) {
+                const char* quote = static_cast<const char*>(memchr(pos, '"', end - pos));
+                if (!quote) {
+                    errorText = "unterminated quote";
+                    pos = end;
+                    break;
+                }
+                if (quote + 1 < end && quote[1] == '"') {
+                    doubled = true;
+                    pos = quote + 2;
+                    continue;
+                }
+                pos = quote + 1;
+                break;
+            }
+            if (!errorText.empty()) break;
+
+            string_view field(fieldStart, pos - 1 - fieldStart);
+            nextLine += count(field.begin(), field.end(), '\n');
+            if (doubled) {
+                // The only copy: collapse "" into "
+                string& copy = unescaped.emplace_back();
+                for (size_t i = 0; i < field.size(); i++) {
+                    copy += field[i];
+                    if (field[i] == '"') i++;
+                }
+                field = copy;
+            }
+            fields.push_back(field);
+            if (pos < end && *pos != ',' && *pos != '\n' && *pos != '\r') {
+                errorText = "unexpected text after a closing quote";
+                break;
+            }
+        } else {
+            const char* fieldStart = pos;
+            while (pos < end && *pos != ',' && *pos != '\n' && *pos != '\r') pos++;
+            fields.emplace_back(fieldStart, pos - fieldStart);
+        }
+
+        if (pos < end && *pos == ',') {
+            pos++;
+            if (pos < end) continue;
+            fields.emplace_back();  // Trailing empty field at end of input
+        }
+        break;
+    }
+
+    if (!errorText.empty()) {
+        // Resynchronise on the next line
+        while (pos < end && *pos != '\n') pos++;
+        fields.clear();
+    }
+    recordText = string_view(start, pos - start);
+    if (!recordText.empty() && recordText.back() == '\r') recordText.remove_suffix(1);
+    if (pos < end && *pos == '\r') pos++;
+    if (pos < end && *pos == '\n') {
+        pos++;
+        nextLine++;
+    }
+    return true;
+}
+
+// Parse a CSV field holding a whole number
+static bool parseField(string_view text, int& value) {
+    auto [rest, error] = from_chars(text.data(), text.data() + text.size(), value);
+    return error == errc() && rest == text.data() + text.size();
+}
+
+// Bind a CSV field in place; the mapped file outlives the statement step
+static void bindField(sqlite3_stmt* stmt, int index, string_view field) {
+    sqlite3_bind_text(stmt, index, field.data(), int(field.size()), SQLITE_STATIC);
+}
+
+// Shared import loop: parse records, hand each to importRow, commit in chunks
+// importRow returns an empty string for a stored row or the reason it was rejected;
+// beforeCommit runs inside the transaction just before each chunk commits
+static bool importCsv(const string& path, const string& rejectPath, size_t columns, size_t optionalColumns,
+                      const char* headerFirstField, ImportStats& stats,
+                      const function<string(const vector<string_view>&)>& importRow,
+                      const function<bool()>& beforeCommit) {
+    stats = ImportStats();
+    MappedFile file;
+    if (!file.open(path)) {
+        cerr << "Can't read import file: " << path << endl;
+        return false;
+    }
+
+    ofstream rejects;  // Opened on the first rejected row
+    auto reject = [&](size_t line, const string& reason, string_view record) {
+        if (!rejects.is_open()) rejects.open(rejectPath);
+        rejects << line << "," << reason << "," << record << "\n";
+        stats.rejected++;
+    };
+
+    CsvReader reader(file.data(), file.size());
+    vector<string_view> fields;
+    unique_ptr<Transaction> txn;
+    size_t chunkRows = 0, chunkStartLine = 0;
+    auto commitChunk = [&]() {
+        if (!txn) return true;
+        bool ok = beforeCommit() && txn->commit();
+        txn.reset();
+        if (!ok) {
+            cerr << "Import stopped: commit failed for rows starting at line " << chunkStartLine
+                 << "; those rows were rolled back\n";
+            stats.imported -= chunkRows;
+        }
+        chunkRows = 0;
+        return ok;
+    };
+
+    bool first = true;
+    while (reader.next(fields)) {
+        if (first && !fields.empty() && fields[0] == headerFirstField) {
+            first = false;
+            continue;  // Header row
+        }
+        first = false;
+        stats.rows++;
+
+        if (!reader.error().empty()) {
+            reject(reader.line(), reader.error(), reader.record());
+            continue;
+        }
+        if (fields.size() < columns || fields.size() > columns + optionalColumns) {
+            reject(reader.line(), "wrong number of columns", reader.record());
+            continue;
+        }
+
+        if (!txn) {
+            txn = make_unique<Transaction>();
+            chunkStartLine = reader.line();
+            if (!txn->active()) return false;
+        }
+        string reason = importRow(fields);
+        if (!reason.empty()) {
+            reject(reader.line(), reason, reader.record());
+            continue;
+        }
+        stats.imported++;
+        if (++chunkRows >= size_t(IMPORT_CHUNK_ROWS) && !commitChunk()) return false;
+    }
+    return commitChunk();
+}
+
+// Import a flight schedule
+bool importFlights(const string& path, const string& rejectPath, ImportStats& stats) {
+    // One statement for the whole file, reset per row
+    StatementHandle stmt("INSERT INTO Flights (flightNumber, airlineName, startingPoint, destination, "
+                         "totalTickets, availableTickets) VALUES (?, ?, ?, ?, ?, ?);");
+    if (!stmt) return false;
+
+    return importCsv(path, rejectPath, 5, 1, "flightNumber", stats,
+        [&](const vector<string_view>& fields) -> string {
+            int total = 0, available = 0;
+            if (!parseField(fields[4], total) || total < 0) return "invalid total tickets";
+            available = total;
+            if (fields.size() == 6 && (!parseField(fields[5], available) || available < 0 || available > total)) {
+                return "invalid available tickets";
+            }
+            if (fields[0].empty()) return "missing flight number";
+
+            sqlite3_reset(stmt.get());
+            for (int i = 0; i < 4; i++) bindField(stmt.get(), i + 1, fields[i]);
+            sqlite3_bind_int(stmt.get(), 5, total);
+            sqlite3_bind_int(stmt.get(), 6, available);
+            int rc = sqlite3_step(stmt.get());
+            if (rc == SQLITE_CONSTRAINT) return "duplicate flight number";
+            return rc == SQLITE_DONE ? "" : "database error";
+        },
+        [] { return true; });
+}
+
+// Import bookings, taking one ticket per stored row
+bool importBookings(const string& path, const string& rejectPath, ImportStats& stats) {
+    // Ticket counts per flight seen in the current chunk, read inside the chunk's transaction
+    // so that writes from other connections between chunks are seen; tickets taken are written
+    // once per chunk and the counts are read again in the next one
+    struct FlightLoad {
+        sqlite3_int64 id = 0;  // Flights.id, 0 if there is no such flight
+        int capacity = 0;      // Total tickets
+        int available = 0;     // Tickets left when the chunk first used the flight
+        int taken = 0;         // Tickets taken in the current chunk
+    };
+    unordered_map<string, FlightLoad> loads;
+    vector<string> touched;  // Flights whose seat maps need reloading
+
+    // One set of statements for the whole file, reset per row
+    StatementHandle flightRow("SELECT id, totalTickets, availableTickets FROM Flights WHERE flightNumber = ?;");
+    StatementHandle addPassenger("INSERT OR IGNORE INTO Passengers (userID, name) VALUES (?, ?);");
+    StatementHandle passengerRow("SELECT id, name FROM Passengers WHERE userID = ?;");
+    StatementHandle dropPassenger("DELETE FROM Passengers WHERE id = ?;");
+    StatementHandle insert("INSERT INTO Bookings (flightID, seatNumber, passengerID) VALUES (?, ?, ?);");
+    StatementHandle take("UPDATE Flights SET availableTickets = availableTickets - ? WHERE id = ?;");
+    if (!flightRow || !addPassenger || !passengerRow || !dropPassenger || !insert || !take) return false;
+    string key;  // Reused lookup key, avoids an allocation per row
+
+    bool ok = importCsv(path, rejectPath, 4, 0, "userID", stats,
+        [&](const vector<string_view>& fields) -> string {
+            int seat = 0;
+            if (fields[0].empty()) return "missing user ID";
+            if (!parseField(fields[3], seat)) return "invalid seat number";
+
+            key.assign(fields[2]);
+            auto [entry, added] = loads.try_emplace(key);
+            FlightLoad& load = entry->second;
+            if (added) {
+                sqlite3_reset(flightRow.get());
+                sqlite3_bind_text(flightRow.get(), 1, key.c_str(), -1, SQLITE_STATIC);
+                if (sqlite3_step(flightRow.get()) == SQLITE_ROW) {
+                    load = FlightLoad{sqlite3_column_int64(flightRow.get(), 0), sqlite3_column_int(flightRow.get(), 1),
+                                      sqlite3_column_int(flightRow.get(), 2), 0};
+                }
+            }
+            if (load.id == 0) return "unknown flight";
+            if (seat < 1 || seat > load.capacity) return "invalid seat number";
+            if (load.available - load.taken <= 0) return "flight is sold out";
+
+            // The passenger's first booking creates the passenger
+            sqlite3_reset(addPassenger.get());
+            bindField(addPassenger.get(), 1, fields[0]);
+            bindField(addPassenger.get(), 2, fields[1]);
+            if (sqlite3_step(addPassenger.get()) != SQLITE_DONE) return "database error";
+            sqlite3* db = sqlite3_db_handle(addPassenger.get());
+            bool created = sqlite3_changes(db) == 1;
+            sqlite3_int64 passengerID = sqlite3_last_insert_rowid(db);
+            if (!created) {
+                sqlite3_reset(passengerRow.get());
+                bindField(passengerRow.get(), 1, fields[0]);
+                if (sqlite3_step(passengerRow.get()) != SQLITE_ROW) return "database error";
+                passengerID = sqlite3_column_int64(passengerRow.get(), 0);
+                string_view name(reinterpret_cast<const char*>(sqlite3_column_text(passengerRow.get(), 1)),
+                                 sqlite3_column_bytes(passengerRow.get(), 1));
+                if (!fields[1].empty() && fields[1] != name) return "user ID is registered under a different name";
+            }
+
+            sqlite3_reset(insert.get());
+            sqlite3_bind_int64(insert.get(), 1, load.id);
+            sqlite3_bind_int(insert.get(), 2, seat);
+            sqlite3_bind_int64(insert.get(), 3, passengerID);
+            int rc = sqlite3_step(insert.get());
+            if (rc != SQLITE_DONE) {
+                bool seatTaken = sqlite3_extended_errcode(db) == SQLITE_CONSTRAINT_PRIMARYKEY;
+                if (created) {
+                    // Don't leave a passenger behind for a rejected row
+                    sqlite3_reset(dropPassenger.get());
+                    sqlite3_bind_int64(dropPassenger.get(), 1, passengerID);
+                    sqlite3_step(dropPassenger.get());
+                }
+                if (rc != SQLITE_CONSTRAINT) return "database error";
+                return seatTaken ? "seat already taken" : "passenger already booked on this flight";
+            }
+            load.taken++;
+            return "";
+        },
+        [&] {
+            // Take this chunk's tickets with one UPDATE per flight
+            for (auto& [flightNumber, load] : loads) {
+                if (load.taken == 0) continue;
+                sqlite3_reset(take.get());
+                sqlite3_bind_int(take.get(), 1, load.taken);
+                sqlite3_bind_int64(take.get(), 2, load.id);
+                if (sqlite3_step(take.get()) != SQLITE_DONE) return false;
+                touched.push_back(flightNumber);
+            }
+            loads.clear();  // Other connections may book or cancel before the next chunk
+            return true;
+        });
+
+    // Seat maps reload from the table on next use
+    for (const string& flightNumber : touched) SeatIndex::instance().invalidate(flightNumber);
+    if (!ok) SeatIndex::instance().clear();
+    return ok;
+}
+
+// Command-line front end for the importers
+int runImport(const string& kind, const string& path, const string& rejectPath) {
+    string rejects = rejectPath.empty() ? path + ".rejects.csv" : rejectPath;
+    ImportStats stats;
+    auto start = chrono::steady_clock::now();
+    bool ok;
+    if (kind == "flights") {
+        ok = importFlights(path, rejects, stats);
+    } else if (kind == "bookings") {
+        ok = importBookings(path, rejects, stats);
+    } else {
+        cerr << "Unknown import type: " << kind << " (expected flights or bookings)" << endl;
+        return 1;
     }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-    User user;  // User object for new data
-    user.userID = userID;
-    // Get new user details from input
-    cout << "Enter New Name: ";
-    getline(cin, user.name);
-    cout << "Enter New Flight Number: ";
-    getline(cin, user.flightNumber);
-    
-    // Check if new flight exists
-    if (!flightExists(user.flightNumber)) {
-        cout << "Flight doesn't exist!\n";
+    cout << "\n--- Import Summary ---\n";
+    cout << left << setw(20) << "Rows read:" << stats.rows << "\n";
+    cout << setw(20) << "Imported:" << stats.imported << "\n";
+    cout << setw(20) << "Rejected:" << stats.rejected << "\n";
+    if (stats.rejected > 0) cout << setw(20) << "Reject file:" << rejects << "\n";
+    cout << setw(20) << "Elapsed (s):" << fixed << setprecision(3) << seconds << "\n";
+    cout << setw(20) << "Rows/s:" << setprecision(0) << (seconds > 0 ? stats.rows / seconds : 0) << "\n";
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+    return ok && stats.imported == stats.rows ? 0 : 1;
+}
+
+void BufferedWriter::write(const char* data, size_t size) {
+    if (used + size > buffer.size()) {
+        flush();
+        if (size > buffer.size()) {
+            // Larger than the whole buffer: write it through
+            for (size_t done = 0; done < size && !failed;) {
+                ssize_t n = ::write(fd, data + done, size - done);
+                if (n < 0) failed = true;
+                else done += n;
+            }
+            return;
+        }
+    }
+    memcpy(buffer.data() + used, data, size);
+    used += size;
+}
+
+void BufferedWriter::writeInt(sqlite3_int64 value) {
+    char digits[24];
+    auto result = to_chars(digits, digits + sizeof(digits), value);
+    write(digits, result.ptr - digits);
+}
+
+bool BufferedWriter::flush() {
+    for (size_t done = 0; done < used && !failed;) {
+        ssize_t n = ::write(fd, buffer.data() + done, used - done);
+        if (n < 0) failed = true;
+        else done += n;
+    }
+    used = 0;
+    return !failed;
+}
+
+// Write a text value as a CSV field, quoting it only when it needs quotes
+static void writeCsvField(BufferedWriter& out, string_view text) {
+    if (text.find_first_of(",\"\r\n") == string_view::npos) {
+        out.write(text);
         return;
     }
+    out.put('"');
+    for (size_t start = 0;;) {
+        size_t quote = text.find('"', start);
+        out.write(text.substr(start, quote - start));
+        if (quote == string_view::npos) break;
+        out.write("\"\"", 2);
+        start = quote + 1;
+    }
+    out.put('"');
+}
+
+// Write a text value as a JSON string
+static void writeJsonString(BufferedWriter& out, string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    out.put('"');
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.write(text.substr(start, i - start));  // Copy the plain run in one go
+        out.put('\\');
+        if (c == '"' || c == '\\') out.put(c);
+        else if (c == '\n') out.put('n');
+        else if (c == '\r') out.put('r');
+        else if (c == '\t') out.put('t');
+        else {
+            out.write("u00", 3);
+            out.put(hex[c >> 4]);
+            out.put(hex[c & 15]);
+        }
+        start = i + 1;
+    }
+    out.write(text.substr(start));
+    out.put('"');
+}
 
-    cout << "Enter New Seat Number: ";
-    cin >> user.seatNumber;
-    cin.ignore(); // Clear input buffer
+// Write a trace time, kept in nanoseconds, as the microseconds the trace format expects
+static void writeTraceMicros(BufferedWriter& out, uint64_t nanos) {
+    out.writeInt(nanos / 1000);
+    char fraction[4] = {'.', char('0' + nanos / 100 % 10), char('0' + nanos / 10 % 10), char('0' + nanos % 10)};
+    out.write(fraction, sizeof(fraction));
+}
 
-    // Check if new seat is available (excluding current user's seat)
-    sqlite3* db;
-    sqlite3_stmt* stmt;
-    bool seatAvailable = true;
+// Write every thread's name and kept spans, oldest first, as a JSON trace-event file
+void TraceRecorder::write() {
+    uint64_t end = now();
+    int pid = getpid();
+    BufferedWriter out(fd);
+    out.write("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool first = true;
+    auto begin = [&](const char* name, const char* phase, int thread) {
+        out.write(first ? "\n{\"name\":" : ",\n{\"name\":");
+        first = false;
+        writeJsonString(out, name);
+        out.write(",\"ph\":\"");
+        out.write(phase);
+        out.write("\",\"pid\":");
+        out.writeInt(pid);
+        out.write(",\"tid\":");
+        out.writeInt(thread);
+    };
 
-    // Open database connection - returns SQLITE_OK if successful
-if (sqlite3_open(DB_FILE.c_str(), &db) == SQLITE_OK) {
-    
-    // SQL query to check if seat is taken by someone else
-    // ? marks are parameter placeholders for:
-    // 1. flightNumber, 2. seatNumber, 3. current userID (to exclude)
-    const char* sql = "SELECT 1 FROM Users WHERE flightNumber = ? AND seatNumber = ? AND userID != ?;";
-    
-    // Prepare the SQL statement for execution
-    // - db: database connection
-    // - sql: query string
-    // - -1: automatic string length detection
-    // - &stmt: will store the prepared statement
-    // - nullptr: unused portion of SQL string
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-        
-        // Bind flightNumber parameter (1st ? placeholder)
-        // - stmt: prepared statement
-        // - 1: parameter index (1-based)
-        // - user.flightNumber.c_str(): value to bind (as C string)
-        // - -1: string length (automatic)
-        // - SQLITE_STATIC: string won't change during execution
-        sqlite3_bind_text(stmt, 1, user.flightNumber.c_str(), -1, SQLITE_STATIC);
-        
-        // Bind seatNumber parameter (2nd ? placeholder)
-        // - 2: parameter index
-        // - user.seatNumber: integer value to bind
-        sqlite3_bind_int(stmt, 2, user.seatNumber);
-        
-        // Bind userID parameter (3rd ? placeholder)
-        // - 3: parameter index
-        // - userID.c_str(): current user's ID to exclude from check
-        sqlite3_bind_text(stmt, 3, userID.c_str(), -1, SQLITE_STATIC);
-        
-        // Execute the prepared statement
-        // SQLITE_ROW means a matching record was found (seat is taken)
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            seatAvailable = false;  // Mark seat as unavailable
+    lock_guard<mutex> lock(mtx);
+    for (const ThreadTrace* trace : threads) {
+        // Tracing is already off, so once a change in progress ends the owner leaves its ring alone
+        while (trace->changing.load(memory_order_acquire)) this_thread::yield();
+        if (!trace->name.empty()) {
+            begin("thread_name", "M", trace->thread);
+            out.write(",\"args\":{\"name\":");
+            writeJsonString(out, trace->name);
+            out.write("}}");
+        }
+        uint64_t oldest = trace->started > TRACE_RING_EVENTS ? trace->started - TRACE_RING_EVENTS : 0;
+        for (uint64_t sequence = oldest; sequence < trace->started; sequence++) {
+            const TraceEvent& event = trace->ring[sequence % TRACE_RING_EVENTS];
+            begin(event.name, "X", trace->thread);
+            out.write(",\"ts\":");
+            writeTraceMicros(out, event.startNanos);
+            out.write(",\"dur\":");
+            // Spans still open at exit are shown ending there
+            writeTraceMicros(out, event.durationNanos == TRACE_OPEN ? end - event.startNanos : event.durationNanos);
+            if (event.detail[0]) {
+                out.write(",\"args\":{\"detail\":");
+                writeJsonString(out, event.detail);
+                out.put('}');
+            }
+            out.put('}');
         }
-        
-        // Clean up the prepared statement
-        sqlite3_finalize(stmt);
     }
-    
-    // Close the database connection
-    sqlite3_close(db);
+    out.write("\n]}\n");
+    if (!out.flush()) cerr << "Can't write trace file" << endl;
 }
 
-    if (!seatAvailable) {
-        cout << "Seat " << user.seatNumber << " is already taken on this flight!\n";
-        return;
+// Stream every row of a query into the writer
+// filters pairs a column with the value it must equal; empty values are skipped
+static bool exportQuery(BufferedWriter& out, ExportFormat format, const char* table,
+                        const vector<const char*>& columns, const vector<pair<const char*, string>>& filters,
+                        size_t& rows) {
+    rows = 0;
+    string sql = "SELECT ";
+    for (size_t i = 0; i < columns.size(); i++) sql += string(i ? ", " : "") + columns[i];
+    sql += string(" FROM ") + table;
+    vector<const string*> values;
+    for (const auto& [column, value] : filters) {
+        if (value.empty()) continue;
+        sql += string(values.empty() ? " WHERE " : " AND ") + column + " = ?";
+        values.push_back(&value);
     }
+    sql += ";";
 
-    // Build SQL update statement
-    string sql = "UPDATE Users SET "
-        "name = '" + user.name + "', "
-        "flightNumber = '" + user.flightNumber + "', "
-        "seatNumber = " + to_string(user.seatNumber) + " "
-        "WHERE userID = '" + userID + "';";
-    
-    // Execute SQL and show result
-    if (executeSQL(sql)) {
-        cout << "User modified successfully.\n";
+    StatementHandle stmt(sql);
+    if (!stmt) return false;
+    for (size_t i = 0; i < values.size(); i++) {
+        sqlite3_bind_text(stmt.get(), int(i + 1), values[i]->c_str(), -1, SQLITE_STATIC);
+    }
+
+    // Column names are formatted once, not per row
+    vector<string> keys;
+    for (size_t i = 0; i < columns.size(); i++) keys.push_back(string(i ? ",\"" : "{\"") + columns[i] + "\":");
+    if (format == ExportFormat::Csv) {
+        for (size_t i = 0; i < columns.size(); i++) {
+            if (i) out.put(',');
+            out.write(columns[i], strlen(columns[i]));
+        }
+        out.put('\n');
+    }
+
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        for (size_t i = 0; i < columns.size(); i++) {
+            int column = int(i);
+            if (format == ExportFormat::Csv) {
+                if (i) out.put(',');
+            } else {
+                out.write(keys[i]);
+            }
+            if (sqlite3_column_type(stmt.get(), column) == SQLITE_INTEGER) {
+                out.writeInt(sqlite3_column_int64(stmt.get(), column));
+            } else {
+                // Text is read in place from SQLite's row buffer
+                const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), column));
+                string_view value(text ? text : "", sqlite3_column_bytes(stmt.get(), column));
+                if (format == ExportFormat::Csv) writeCsvField(out, value);
+                else writeJsonString(out, value);
+            }
+        }
+        if (format == ExportFormat::JsonLines) out.put('}');
+        out.put('\n');
+        rows++;
+    }
+    if (rc != SQLITE_DONE) {
+        cerr << "SQL error: " << sqlite3_errmsg(sqlite3_db_handle(stmt.get())) << endl;
+        return false;
     }
+    return true;
 }
 
-// Delete a user from the database
-void deleteUser() {
-    string userID;  // User ID to delete
-    cout << "\nEnter User ID to delete: ";
-    getline(cin, userID);
+// Export flights
+bool exportFlights(BufferedWriter& out, ExportFormat format, const ExportFilter& filter, size_t& rows) {
+    return exportQuery(out, format, "Flights",
+                       {"flightNumber", "airlineName", "startingPoint", "destination", "totalTickets", "availableTickets"},
+                       {{"flightNumber", filter.flightNumber}, {"airlineName", filter.airlineName},
+                        {"startingPoint", filter.startingPoint}, {"destination", filter.destination}},
+                       rows);
+}
 
-    // Check if user exists
-    if (!userExists(userID)) {
-        cout << "User not found!\n";
-        return;
+// Export users
+bool exportUsers(BufferedWriter& out, ExportFormat format, const ExportFilter& filter, size_t& rows) {
+    return exportQuery(out, format, "Users", {"userID", "name", "flightNumber", "seatNumber"},
+                       {{"flightNumber", filter.flightNumber}}, rows);
+}
+
+// Parse export arguments, open the destination and run the export
+int runExport(const vector<string>& args) {
+    const char* usage = "Usage: --export <flights|users> <csv|jsonl> <file|-> "
+                        "[--flight F] [--airline A] [--from X] [--to Y]";
+    if (args.size() < 3 || args.size() % 2 == 0 ||
+        (args[0] != "flights" && args[0] != "users") || (args[1] != "csv" && args[1] != "jsonl")) {
+        cerr << usage << endl;
+        return 1;
     }
+    bool users = args[0] == "users";
+    ExportFormat format = args[1] == "csv" ? ExportFormat::Csv : ExportFormat::JsonLines;
 
-    // Get flight number before deleting to update available tickets
-    string flightNumber;
-    sqlite3* db;
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_open(DB_FILE.c_str(), &db) == SQLITE_OK) {
-        string sql = "SELECT flightNumber FROM Users WHERE userID = '" + userID + "';";
-        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-            if (sqlite3_step(stmt) == SQLITE_ROW) {
-                flightNumber = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-            }
-            sqlite3_finalize(stmt);
+    ExportFilter filter;
+    for (size_t i = 3; i + 1 < args.size(); i += 2) {
+        const string& option = args[i];
+        if (option == "--flight") filter.flightNumber = args[i + 1];
+        else if (option == "--airline" && !users) filter.airlineName = args[i + 1];
+        else if (option == "--from" && !users) filter.startingPoint = args[i + 1];
+        else if (option == "--to" && !users) filter.destination = args[i + 1];
+        else {
+            cerr << "Unknown export filter for " << args[0] << ": " << option << "\n" << usage << endl;
+            return 1;
         }
-        sqlite3_close(db);
     }
 
-    // Build and execute delete statement
-    string deleteSql = "DELETE FROM Users WHERE userID = '" + userID + "';";
-    if (executeSQL(deleteSql)) {
-        // Increment available tickets if flight number was found
-        if (!flightNumber.empty()) {
-            string updateSql = "UPDATE Flights SET availableTickets = availableTickets + 1 "
-                "WHERE flightNumber = '" + flightNumber + "';";
-            executeSQL(updateSql);
+    const string& path = args[2];
+    int fd = STDOUT_FILENO;
+    if (path == "-") {
+        cout.flush();  // Keep anything already printed ahead of the data
+    } else {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            cerr << "Can't open export file: " << path << endl;
+            return 1;
         }
-        cout << "User deleted successfully.\n";
     }
+
+    auto start = chrono::steady_clock::now();
+    size_t rows = 0;
+    bool ok;
+    bool written;
+    {
+        BufferedWriter out(fd);
+        ok = users ? exportUsers(out, format, filter, rows) : exportFlights(out, format, filter, rows);
+        written = out.flush();
+    }
+    if (fd != STDOUT_FILENO) written = close(fd) == 0 && written;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (!written) cerr << "Write failed: " << path << endl;
+    cerr << "Exported " << rows << " " << args[0] << " in " << fixed << setprecision(3) << seconds << "s\n";
+    cerr.unsetf(ios::floatfield);
+    return ok && written ? 0 : 1;
 }
 
-// Make a flight reservation
-void makeReservation() {
-    string userID, flightNumber;
-    cout << "\nEnter User ID: ";
-    getline(cin, userID);
-    
-    // Check if user already exists
-    if (userExists(userID)) {
-        cout << "User with this ID already exists!\n";
-        return;
+// Fill the scratch database: flights on random city pairs, then passengers with one
+// booking each, dealt round the flights so that every flight fills evenly
+static bool seedBenchDatabase(int flights, int seats, int passengers, mt19937& random,
+                              vector<string>& flightNumbers, vector<string>& userIDs) {
+    static const char* airlines[] = {"Aurora Air", "Blue Meridian", "Cascade Airways", "Delta Wing", "Equator"};
+    static const char* cities[] = {"Amsterdam", "Bangkok", "Chicago", "Denver", "Edinburgh", "Frankfurt",
+                                   "Geneva", "Helsinki", "Istanbul", "Johannesburg", "Kyoto", "Lisbon",
+                                   "Madrid", "Nairobi", "Oslo", "Paris", "Quito", "Rome", "Seattle", "Toronto"};
+    const int cityCount = sizeof(cities) / sizeof(cities[0]);
+
+    Transaction txn;
+    if (!txn.active()) return false;
+    StatementHandle addFlight("INSERT INTO Flights (flightNumber, airlineName, startingPoint, destination, "
+                              "totalTickets, availableTickets) VALUES (?, ?, ?, ?, ?, ?);");
+    StatementHandle addPassenger("INSERT INTO Passengers (userID, name) VALUES (?, ?);");
+    StatementHandle addBooking("INSERT INTO Bookings (flightID, seatNumber, passengerID) VALUES (?, ?, ?);");
+    if (!addFlight || !addPassenger || !addBooking) return false;
+
+    vector<sqlite3_int64> flightIDs;
+    char text[32];
+    for (int i = 0; i < flights; i++) {
+        snprintf(text, sizeof(text), "BF%05d", i + 1);
+        flightNumbers.push_back(text);
+        int from = random() % cityCount;
+        int to = (from + 1 + random() % (cityCount - 1)) % cityCount;
+        int booked = passengers / flights + (i < passengers % flights ? 1 : 0);
+        sqlite3_bind_text(addFlight.get(), 1, text, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(addFlight.get(), 2, airlines[i % 5], -1, SQLITE_STATIC);
+        sqlite3_bind_text(addFlight.get(), 3, cities[from], -1, SQLITE_STATIC);
+        sqlite3_bind_text(addFlight.get(), 4, cities[to], -1, SQLITE_STATIC);
+        sqlite3_bind_int(addFlight.get(), 5, seats);
+        sqlite3_bind_int(addFlight.get(), 6, seats - booked);
+        if (sqlite3_step(addFlight.get()) != SQLITE_DONE) return false;
+        sqlite3_reset(addFlight.get());
+        flightIDs.push_back(sqlite3_last_insert_rowid(sqlite3_db_handle(addFlight.get())));
     }
 
-    cout << "Enter Flight Number: ";
-    getline(cin, flightNumber);
+    for (int i = 0; i < passengers; i++) {
+        snprintf(text, sizeof(text), "BP%07d", i + 1);
+        userIDs.push_back(text);
+        string name = "Passenger " + to_string(i + 1);
+        sqlite3_bind_text(addPassenger.get(), 1, text, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(addPassenger.get(), 2, name.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(addPassenger.get()) != SQLITE_DONE) return false;
+        sqlite3_reset(addPassenger.get());
 
-    // Check available tickets
-    sqlite3* db;
-    sqlite3_stmt* stmt;
-    int availableTickets = -1;
-    
-    if (sqlite3_open(DB_FILE.c_str(), &db) == SQLITE_OK) {
-        string sql = "SELECT availableTickets FROM Flights WHERE flightNumber = '" + flightNumber + "';";
-        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-            if (sqlite3_step(stmt) == SQLITE_ROW) {
-                availableTickets = sqlite3_column_int(stmt, 0);
-            }
-            sqlite3_finalize(stmt);
+        sqlite3_bind_int64(addBooking.get(), 1, flightIDs[i % flights]);
+        sqlite3_bind_int(addBooking.get(), 2, i / flights + 1);
+        sqlite3_bind_int64(addBooking.get(), 3, sqlite3_last_insert_rowid(sqlite3_db_handle(addPassenger.get())));
+        if (sqlite3_step(addBooking.get()) != SQLITE_DONE) return false;
+        sqlite3_reset(addBooking.get());
+    }
+    return txn.commit();
+}
+
+// Recreate a scratch database, open it with room for extra threads and seed it
+// @return: false (after saying why) if it can't be created or seeded
+static bool prepareScratchDatabase(const string& dbFile, size_t threads, int flights, int seats, int passengers,
+                                   mt19937& random, vector<string>& flightNumbers, vector<string>& userIDs) {
+    if (dbFile == DB_FILE) {
+        cerr << "Scratch databases are recreated on every run; choose a file other than " << DB_FILE << endl;
+        return false;
+    }
+    for (const char* suffix : {"", "-wal", "-shm"}) unlink((dbFile + suffix).c_str());
+    // Worker threads keep their connections, besides main, the group-commit writer and the checkpointer
+    ConnectionPool::instance().configure(dbFile, max(MAX_CONNECTIONS, threads + SERVICE_CONNECTIONS));
+    initializeDatabase(false);
+
+    auto start = chrono::steady_clock::now();
+    if (!seedBenchDatabase(flights, seats, passengers, random, flightNumbers, userIDs) ||
+        !FlightCatalog::instance().load()) {
+        cerr << "Couldn't seed " << dbFile << endl;
+        return false;
+    }
+    SeatIndex::instance().clear();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Seeded " << flights << " flights and " << passengers << " passengers in "
+         << fixed << setprecision(3) << seconds << "s\n";
+    cout.unsetf(ios::floatfield);
+    return true;
+}
+
+// Latencies of one benchmark
+struct BenchResult {
+    string name;              // Benchmark name
+    double seconds = 0;       // Wall time of the timed loop
+    vector<double> latencies; // Microseconds per call
+};
+
+// Time ops calls of op(i), one at a time
+template <typename Op>
+static BenchResult measure(const string& name, int ops, Op op) {
+    BenchResult result;
+    result.name = name;
+    result.latencies.reserve(ops);
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < ops; i++) {
+        auto before = chrono::steady_clock::now();
+        op(i);
+        result.latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - before).count());
+    }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+// Nearest-rank percentile of sorted latencies
+static double percentile(const vector<double>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(ceil(fraction * sorted.size()));
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+// Swallows the display functions' output while they are timed
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+// Parse options, seed the scratch database, run every benchmark and report
+int runBench(const vector<string>& args) {
+    const char* usage = "Usage: --bench [--db FILE] [--output FILE] [--flights N] [--seats N] "
+                        "[--passengers N] [--ops N] [--queued-ops N] [--seed N]";
+    BenchConfig config;
+    for (size_t i = 0; i < args.size(); i += 2) {
+        const string& option = args[i];
+        if (i + 1 == args.size()) {
+            cerr << usage << endl;
+            return 1;
+        }
+        const string& value = args[i + 1];
+        int number = 0;
+        bool numeric = option != "--db" && option != "--output";
+        if (numeric && (!parseNumber(value, number) || number < 0)) {
+            cerr << "Not a count for " << option << ": " << value << "\n" << usage << endl;
+            return 1;
+        }
+        if (option == "--db") config.dbFile = value;
+        else if (option == "--output") config.outputFile = value;
+        else if (option == "--flights") config.flights = number;
+        else if (option == "--seats") config.seats = number;
+        else if (option == "--passengers") config.passengers = number;
+        else if (option == "--ops") config.ops = number;
+        else if (option == "--queued-ops") config.queuedOps = number;
+        else if (option == "--seed") config.seed = number;
+        else {
+            cerr << "Unknown bench option: " << option << "\n" << usage << endl;
+            return 1;
         }
-        sqlite3_close(db);
+    }
+    if (config.flights < 1 || config.seats < 1 || config.ops < 1 || config.queuedOps < 1 ||
+        config.passengers > static_cast<long long>(config.flights) * config.seats) {
+        cerr << "Need at least one flight, seat and op, and no more passengers than seats" << endl;
+        return 1;
     }
 
-    if (availableTickets == -1) {
-        cout << "Flight not found.\n";
-        return;
+    mt19937 random(config.seed);
+    vector<string> flightNumbers, userIDs;
+    if (!prepareScratchDatabase(config.dbFile, 1, config.flights, config.seats, config.passengers,
+                                random, flightNumbers, userIDs)) {
+        return 1;
     }
 
-    if (availableTickets <= 0) {
-        cout << "No available tickets for this flight.\n";
-        return;
+    // Argument lists are drawn up front so that only the calls themselves are timed
+    auto pick = [&](const vector<string>& from) { return from[random() % from.size()]; };
+    vector<string> flightArgs, userArgs;
+    vector<int> seatArgs;
+    for (int i = 0; i < config.ops; i++) {
+        flightArgs.push_back(pick(flightNumbers));
+        userArgs.push_back(userIDs.empty() ? "BP-none" : pick(userIDs));
+        seatArgs.push_back(1 + random() % config.seats);
     }
 
-    // Show taken seats
-    vector<int> takenSeats = getTakenSeats(flightNumber);
-    cout << "Taken seats: ";
-    for (int seat : takenSeats) {
-        cout << seat << " ";
+    vector<BenchResult> results;
+    results.push_back(measure("flightExists", config.ops, [&](int i) { flightExists(flightArgs[i]); }));
+    results.push_back(measure("userExists", config.ops, [&](int i) { userExists(userArgs[i]); }));
+    results.push_back(measure("isSeatAvailable", config.ops, [&](int i) { isSeatAvailable(flightArgs[i], seatArgs[i]); }));
+    results.push_back(measure("getTakenSeats", config.ops, [&](int i) { getTakenSeats(flightArgs[i]); }));
+
+    // Book new passengers into free seats, then cancel the same bookings in random order,
+    // calling the engine directly: this leaves out the group-commit queue's window
+    vector<User> bookings;
+    for (int i = 0; i < config.ops; i++) {
+        User user;
+        user.userID = "BN" + to_string(i + 1);
+        user.name = "Bench " + to_string(i + 1);
+        user.flightNumber = flightArgs[i];
+        bookings.push_back(user);
     }
-    cout << endl;
+    int failed = 0;
+    results.push_back(measure("reserveSeat", config.ops, [&](int i) {
+        User& user = bookings[i];
+        user.seatNumber = findFreeSeats(user.flightNumber, 1);  // Seat choice, as submitBooking makes it
+        if (user.seatNumber == 0 || reserveSeat(user) != ReservationResult::Ok) {
+            user.seatNumber = 0;
+            failed++;
+        }
+    }));
+    shuffle(bookings.begin(), bookings.end(), random);
+    results.push_back(measure("cancelBooking", config.ops, [&](int i) {
+        if (bookings[i].seatNumber == 0) return;  // Not booked (flight full)
+        if (cancelBooking(bookings[i].userID, bookings[i].flightNumber) != ReservationResult::Ok) failed++;
+    }));
 
-    User user;
-    user.userID = userID;
-    cout << "Enter Name: ";
-    getline(cin, user.name);
-    user.flightNumber = flightNumber;
-    cout << "Enter Seat Number: ";
-    cin >> user.seatNumber;
-    cin.ignore(); // Clear input buffer
+    // The same through the group-commit queue, which is how the menu books and cancels
+    int queuedOps = min(config.ops, config.queuedOps);
+    vector<User> queued(bookings.begin(), bookings.begin() + queuedOps);
+    for (int i = 0; i < queuedOps; i++) queued[i].userID = "BQ" + to_string(i + 1);
+    results.push_back(measure("submitBooking", queuedOps, [&](int i) {
+        User& user = queued[i];
+        user.seatNumber = 0;  // Chosen by submitBooking
+        if (submitBooking(user) != ReservationResult::Ok) {
+            user.seatNumber = 0;
+            failed++;
+        }
+    }));
+    shuffle(queued.begin(), queued.end(), random);
+    results.push_back(measure("submitCancellation", queuedOps, [&](int i) {
+        if (queued[i].seatNumber == 0) return;  // Not booked (flight full)
+        if (BookingQueue::instance().submitCancellation(queued[i].userID, queued[i].flightNumber).get() !=
+            ReservationResult::Ok) {
+            failed++;
+        }
+    }));
 
-    // Check if seat is available
-    if (!isSeatAvailable(flightNumber, user.seatNumber)) {
-        cout << "Seat " << user.seatNumber << " is already taken on this flight!\n";
-        return;
+    {
+        // Display functions print to cout and ask for more pages on cin; each call shows one page
+        NullBuffer discard;
+        istringstream noMore;
+        streambuf* out = cout.rdbuf(&discard);
+        streambuf* in = cin.rdbuf(noMore.rdbuf());
+        results.push_back(measure("displayFlights", config.ops, [&](int) { displayFlights(); cin.clear(); }));
+        results.push_back(measure("displayUsers", config.ops, [&](int) { displayUsers(); cin.clear(); }));
+        cout.rdbuf(out);
+        cin.rdbuf(in);
     }
 
-    // Build and execute insert statement
-    string insertSql = "INSERT INTO Users VALUES ('" + user.userID + "', '" 
-        + user.name + "', '" + user.flightNumber + "', " 
-        + to_string(user.seatNumber) + ");";
-    
-    // Execute SQL and update available tickets
-    if (executeSQL(insertSql)) {
-        string updateSql = "UPDATE Flights SET availableTickets = availableTickets - 1 "
-            "WHERE flightNumber = '" + flightNumber + "';";
-        executeSQL(updateSql);
-        cout << "Reservation successful! Seat booked.\n";
+    ofstream file(config.outputFile);
+    if (!file) {
+        cerr << "Can't write " << config.outputFile << endl;
+        return 1;
     }
+    file << "# flights=" << config.flights << " seats=" << config.seats << " passengers=" << config.passengers
+         << " ops=" << config.ops << " seed=" << config.seed << " sqlite=" << sqlite3_libversion() << "\n";
+    file << "benchmark\tops\tseconds\tops_per_s\tmean_us\tp50_us\tp90_us\tp99_us\tp999_us\tmax_us\n";
+    file << fixed << setprecision(3);
+
+    cout << "\n--- Benchmark Results (latency in microseconds) ---\n";
+    cout << left << setw(20) << "Benchmark" << right << setw(12) << "ops/s" << setw(10) << "mean"
+         << setw(10) << "p50" << setw(10) << "p99" << setw(10) << "p99.9" << setw(10) << "max" << "\n";
+    cout << fixed;
+    for (const BenchResult& result : results) {
+        double mean = 0;
+        for (double latency : result.latencies) mean += latency;
+        mean /= result.latencies.size();
+        double rate = result.seconds > 0 ? result.latencies.size() / result.seconds : 0;
+        file << result.name << "\t" << result.latencies.size() << "\t" << result.seconds << "\t" << rate
+             << "\t" << mean << "\t" << percentile(result.latencies, 0.5) << "\t" << percentile(result.latencies, 0.9)
+             << "\t" << percentile(result.latencies, 0.99) << "\t" << percentile(result.latencies, 0.999)
+             << "\t" << result.latencies.back() << "\n";
+        cout << left << setw(20) << result.name << right << setprecision(0) << setw(12) << rate << setprecision(2)
+             << setw(10) << mean << setw(10) << percentile(result.latencies, 0.5)
+             << setw(10) << percentile(result.latencies, 0.99) << setw(10) << percentile(result.latencies, 0.999)
+             << setw(10) << result.latencies.back() << "\n";
+    }
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+    if (failed > 0) cout << failed << " bookings or cancellations didn't go through\n";
+    cout << "Results written to " << config.outputFile << "\n";
+    return file.good() ? 0 : 1;
 }
 
-// Cancel a reservation
-void cancelReservation() {
-    string userID;
-    cout << "\nEnter User ID to cancel reservation: ";
-    getline(cin, userID);
+// Operations run by the load generator, in LoadConfig::mix order
+static const char* LOAD_OPS[] = {"book", "cancel", "modify", "seats"};
 
-    // Check if user exists
-    if (!userExists(userID)) {
-        cout << "User not found!\n";
-        return;
+// What one load generator agent saw for one operation
+struct LoadCounters {
+    vector<double> latencies;  // Microseconds per operation
+    size_t ok = 0;             // Operations that succeeded
+    size_t conflicts = 0;      // Attempts that lost their seat to another agent
+    size_t retries = 0;        // Attempts repeated after a conflict
+    size_t soldOut = 0;        // Bookings or moves that found no free seat
+    size_t failed = 0;         // Other failures (database errors, nothing to cancel)
+};
+
+// Picks flight indexes with Zipf-distributed popularity: index k-1 has weight 1/k^s
+class ZipfPicker {
+public:
+    ZipfPicker(size_t count, double s) : cumulative(count) {
+        double total = 0;
+        for (size_t k = 0; k < count; k++) cumulative[k] = total += 1 / pow(k + 1.0, s);
+        for (double& weight : cumulative) weight /= total;
     }
 
-    // Get flight number before deleting
-    string flightNumber;
-    sqlite3* db;
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_open(DB_FILE.c_str(), &db) == SQLITE_OK) {
-        string sql = "SELECT flightNumber FROM Users WHERE userID = '" + userID + "';";
-        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-            if (sqlite3_step(stmt) == SQLITE_ROW) {
-                flightNumber = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    size_t operator()(mt19937& random) const {
+        double u = uniform_real_distribution<double>(0, 1)(random);
+        return min<size_t>(lower_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin(),
+                           cumulative.size() - 1);
+    }
+
+private:
+    vector<double> cumulative;  // Running share of the weight up to each index
+};
+
+// Attempts at a seat before an operation gives up on conflicts, as submitBooking does
+static const int LOAD_SEAT_ATTEMPTS = 3;
+
+// One agent: runs operations until the deadline, on schedule when interval > 0
+static void runLoadAgent(const LoadConfig& config, size_t agent, const vector<string>& flightNumbers,
+                         const ZipfPicker& popularity, vector<User> held, chrono::steady_clock::time_point start,
+                         chrono::steady_clock::time_point deadline, array<LoadCounters, 4>& counters) {
+    using clock = chrono::steady_clock;
+    TraceRecorder::nameThread("agent " + to_string(agent));
+    mt19937 random(config.seed * 7919 + agent);
+    discrete_distribution<int> pickOp(begin(config.mix), end(config.mix));
+    auto interval = config.rate > 0
+        ? chrono::duration_cast<clock::duration>(chrono::duration<double>(config.threads / config.rate))
+        : clock::duration::zero();
+    clock::time_point next = start + interval * agent / config.threads;  // Spread the agents' schedules
+    size_t created = 0;
+
+    // Take a free seat on user.flightNumber through attempt(), choosing again after a conflict
+    auto withFreeSeat = [&](LoadCounters& counter, User& user, const function<ReservationResult()>& attempt) {
+        ReservationResult result = ReservationResult::SeatTaken;
+        for (int tries = 0; tries < LOAD_SEAT_ATTEMPTS && result == ReservationResult::SeatTaken; tries++) {
+            if (tries > 0) counter.retries++;
+            user.seatNumber = findFreeSeats(user.flightNumber, 1);
+            if (user.seatNumber == 0) return ReservationResult::SoldOut;
+            result = attempt();
+            if (result == ReservationResult::SeatTaken) counter.conflicts++;
+        }
+        return result;
+    };
+
+    while (true) {
+        clock::time_point began;
+        if (interval > clock::duration::zero()) {
+            if (next >= deadline) break;
+            this_thread::sleep_until(next);
+            began = next;  // Time spent behind schedule counts as latency
+            next += interval;
+        } else {
+            began = clock::now();
+            if (began >= deadline) break;
+        }
+
+        int op = pickOp(random);
+        TraceSpan span(LOAD_OPS[op]);
+        LoadCounters& counter = counters[op];
+        ReservationResult result = ReservationResult::Ok;
+        if (op == 0) {
+            User user;
+            user.userID = "LG" + to_string(agent) + "-" + to_string(++created);
+            user.name = "Agent " + to_string(agent) + " passenger";
+            user.flightNumber = flightNumbers[popularity(random)];
+            result = withFreeSeat(counter, user, [&] { return BookingQueue::instance().submitReservation(user).get(); });
+            if (result == ReservationResult::Ok) held.push_back(user);
+        } else if (op == 1 || op == 2) {
+            if (held.empty()) {
+                result = ReservationResult::NoReservation;
+            } else {
+                size_t which = random() % held.size();
+                if (op == 1) {
+                    result = BookingQueue::instance().submitCancellation(held[which].userID, held[which].flightNumber).get();
+                    if (result == ReservationResult::Ok) {
+                        held[which] = held.back();
+                        held.pop_back();
+                    }
+                } else {
+                    User moved = held[which];
+                    moved.flightNumber = flightNumbers[popularity(random)];
+                    result = withFreeSeat(counter, moved, [&] { return modifyBooking(moved, held[which].flightNumber); });
+                    if (result == ReservationResult::Ok) held[which] = moved;
+                }
             }
-            sqlite3_finalize(stmt);
+        } else {
+            getTakenSeats(flightNumbers[popularity(random)]);
         }
-        sqlite3_close(db);
+
+        counter.latencies.push_back(chrono::duration<double, micro>(clock::now() - began).count());
+        if (result == ReservationResult::Ok) counter.ok++;
+        else if (result == ReservationResult::SoldOut) counter.soldOut++;
+        else if (result != ReservationResult::SeatTaken) counter.failed++;  // Conflicts are counted per attempt
     }
+}
 
-    // Build and execute delete statement
-    string deleteSql = "DELETE FROM Users WHERE userID = '" + userID + "';";
-    if (executeSQL(deleteSql)) {
-        // Update available tickets if flight number was found
-        if (!flightNumber.empty()) {
-            string updateSql = "UPDATE Flights SET availableTickets = availableTickets + 1 "
-                "WHERE flightNumber = '" + flightNumber + "';";
-            executeSQL(updateSql);
+// Parse options, seed the scratch database, run the agents and report
+int runLoadGen(const vector<string>& args) {
+    const char* usage = "Usage: --loadgen [--db FILE] [--flights N] [--seats N] [--passengers N] [--threads N] "
+                        "[--seconds S] [--rate OPS] [--zipf S] [--mix book:N,cancel:N,modify:N,seats:N] [--seed N]";
+    LoadConfig config;
+    for (size_t i = 0; i < args.size(); i += 2) {
+        const string& option = args[i];
+        if (i + 1 == args.size()) {
+            cerr << usage << endl;
+            return 1;
         }
-        cout << "Reservation canceled successfully.\n";
+        const string& value = args[i + 1];
+        int number = 0;
+        double real = 0;
+        bool valid = true;
+        if (option == "--db") {
+            config.dbFile = value;
+        } else if (option == "--mix") {
+            fill(begin(config.mix), end(config.mix), 0);
+            istringstream parts(value);
+            string part;
+            while (getline(parts, part, ',')) {
+                size_t colon = part.find(':');
+                auto name = find(begin(LOAD_OPS), end(LOAD_OPS), part.substr(0, colon));
+                valid = valid && colon != string::npos && name != end(LOAD_OPS) &&
+                        parseNumber(part.substr(colon + 1), number) && number >= 0;
+                if (valid) config.mix[name - begin(LOAD_OPS)] = number;
+            }
+            valid = valid && any_of(begin(config.mix), end(config.mix), [](int weight) { return weight > 0; });
+        } else if (option == "--seconds" || option == "--rate" || option == "--zipf") {
+            char* end = nullptr;
+            real = strtod(value.c_str(), &end);
+            valid = !value.empty() && *end == '\0' && real >= 0;
+            if (option == "--seconds") config.seconds = real;
+            else if (option == "--rate") config.rate = real;
+            else config.zipf = real;
+        } else if (parseNumber(value, number) && number >= 0) {
+            if (option == "--flights") config.flights = number;
+            else if (option == "--seats") config.seats = number;
+            else if (option == "--passengers") config.passengers = number;
+            else if (option == "--threads") config.threads = number;
+            else if (option == "--seed") config.seed = number;
+            else valid = false;
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            cerr << "Bad load generator option: " << option << " " << value << "\n" << usage << endl;
+            return 1;
+        }
+    }
+    if (config.flights < 1 || config.seats < 1 || config.threads < 1 ||
+        config.passengers > static_cast<long long>(config.flights) * config.seats) {
+        cerr << "Need at least one flight, seat and thread, and no more passengers than seats" << endl;
+        return 1;
+    }
+    if (config.threads > MAX_SCRATCH_CONNECTIONS - SERVICE_CONNECTIONS) {
+        // Each agent keeps a connection for the whole run; more agents than connections would wait forever
+        cerr << "At most " << MAX_SCRATCH_CONNECTIONS - SERVICE_CONNECTIONS << " threads: each agent keeps "
+             << "its own database connection" << endl;
+        return 1;
+    }
+
+    mt19937 random(config.seed);
+    vector<string> flightNumbers, userIDs;
+    if (!prepareScratchDatabase(config.dbFile, config.threads, config.flights, config.seats, config.passengers,
+                                random, flightNumbers, userIDs)) {
+        return 1;
+    }
+
+    // Deal the seeded bookings out to the agents; passenger i is on flight i % flights
+    vector<vector<User>> held(config.threads);
+    for (size_t i = 0; i < userIDs.size(); i++) {
+        User user;
+        user.userID = userIDs[i];
+        user.name = "Passenger " + to_string(i + 1);
+        user.flightNumber = flightNumbers[i % flightNumbers.size()];
+        user.seatNumber = static_cast<int>(i / flightNumbers.size()) + 1;
+        held[i % config.threads].push_back(user);
+    }
+    // Popularity follows a shuffled flight order, so hot flights are spread over routes
+    vector<string> byPopularity = flightNumbers;
+    shuffle(byPopularity.begin(), byPopularity.end(), random);
+    ZipfPicker popularity(byPopularity.size(), config.zipf);
+
+    cout << "Running " << config.threads << " agents for " << config.seconds << "s "
+         << (config.rate > 0 ? "at " + to_string(static_cast<long long>(config.rate)) + " ops/s" : string("closed loop"))
+         << ", zipf " << config.zipf << "\n";
+    vector<array<LoadCounters, 4>> counters(config.threads);
+    vector<thread> agents;
+    auto start = chrono::steady_clock::now() + chrono::milliseconds(10);  // Let every agent reach the start line
+    auto deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(config.seconds));
+    for (size_t agent = 0; agent < config.threads; agent++) {
+        agents.emplace_back(runLoadAgent, cref(config), agent, cref(byPopularity), cref(popularity),
+                            move(held[agent]), start, deadline, ref(counters[agent]));
     }
+    for (thread& agent : agents) agent.join();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "\n--- Load Generator Results (latency in microseconds) ---\n";
+    cout << left << setw(8) << "Op" << right << setw(10) << "count" << setw(10) << "ops/s" << setw(10) << "p50"
+         << setw(10) << "p99" << setw(10) << "p99.9" << setw(10) << "ok" << setw(11) << "conflicts"
+         << setw(9) << "retries" << setw(9) << "soldout" << setw(8) << "failed" << "\n";
+    size_t total = 0;
+    cout << fixed;
+    for (int op = 0; op < 4; op++) {
+        LoadCounters merged;
+        for (const auto& agent : counters) {
+            const LoadCounters& counter = agent[op];
+            merged.latencies.insert(merged.latencies.end(), counter.latencies.begin(), counter.latencies.end());
+            merged.ok += counter.ok;
+            merged.conflicts += counter.conflicts;
+            merged.retries += counter.retries;
+            merged.soldOut += counter.soldOut;
+            merged.failed += counter.failed;
+        }
+        sort(merged.latencies.begin(), merged.latencies.end());
+        total += merged.latencies.size();
+        cout << left << setw(8) << LOAD_OPS[op] << right << setw(10) << merged.latencies.size() << setprecision(0)
+             << setw(10) << merged.latencies.size() / elapsed << setprecision(1)
+             << setw(10) << percentile(merged.latencies, 0.5) << setw(10) << percentile(merged.latencies, 0.99)
+             << setw(10) << percentile(merged.latencies, 0.999) << setw(10) << merged.ok << setw(11) << merged.conflicts
+             << setw(9) << merged.retries << setw(9) << merged.soldOut << setw(8) << merged.failed << "\n";
+    }
+    cout << setprecision(0) << "Total: " << total << " operations, " << total / elapsed << " ops/s over "
+         << setprecision(2) << elapsed << "s\n";
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+    return 0;
 }
 
-// Display all flights
-void displayFlights() {
-    cout << "\n--- Flight Information ---\n";
-    string sql = "SELECT * FROM Flights ORDER BY flightNumber;";
-    executeSQLWithCallback(sql, flightCallback);
+// Statements that may scan a whole table (normalized text, and why)
+static const pair<const char*, const char*> PLAN_SCAN_ALLOWED[] = {
+    {"SELECT ? FROM sqlite_master WHERE type = ? AND name = ?;", "schema lookups at startup"},
+    {"SELECT rowid, flightNumber, airlineName, startingPoint, destination, totalTickets, availableTickets "
+     "FROM Flights;", "flight catalog load reads every flight"},
+    {"SELECT flightNumber, airlineName, startingPoint, destination, totalTickets, availableTickets "
+     "FROM Flights WHERE availableTickets > ?;", "connection search inside a transaction that changed flights"},
+    {"SELECT flightNumber, airlineName, startingPoint, destination, totalTickets, availableTickets "
+     "FROM Flights;", "unfiltered flight export"},
+    {"SELECT userID, name, flightNumber, seatNumber FROM Users;", "unfiltered user export"},
+};
+
+// Statements that may fail to EXPLAIN once the workload is done (normalized text prefix, and why);
+// any other statement that can't be explained fails the check
+static const pair<const char*, const char*> PLAN_UNEXPLAINABLE[] = {
+    {"CREATE ", "schema migration; the object already exists"},
+    {"DROP TABLE Legacy", "schema migration; the table is gone"},
+    {"ALTER TABLE Users RENAME TO Legacy", "schema migration; Users is a view now"},
+    {"SELECT lastRowid FROM MigrationProgress ", "migration progress; the table only exists mid-migration"},
+    {"SELECT max(rowid) FROM Legacy", "migration source; the table is gone"},
+    {"SELECT count(*) FROM LegacyOrphans", "migration leftovers; the table is dropped when empty"},
+};
+
+// Parse options, run the workload with profiling on and check every statement's plan
+int runPlanCheck(const vector<string>& args) {
+    const char* usage = "Usage: --check-plans [--db FILE] [--flights N] [--seats N] [--passengers N] [--verbose]";
+    string dbFile = "plancheck.db";
+    int flights = 200, seats = 100, passengers = 5000;
+    bool verbose = false;
+    for (size_t i = 0; i < args.size(); i++) {
+        int number = 0;
+        if (args[i] == "--verbose") {
+            verbose = true;
+        } else if (i + 1 < args.size() && args[i] == "--db") {
+            dbFile = args[++i];
+        } else if (i + 1 < args.size() && parseNumber(args[i + 1], number) && number > 0 &&
+                   (args[i] == "--flights" || args[i] == "--seats" || args[i] == "--passengers")) {
+            (args[i] == "--flights" ? flights : args[i] == "--seats" ? seats : passengers) = number;
+            i++;
+        } else {
+            cerr << usage << endl;
+            return 1;
+        }
+    }
+    if (passengers > static_cast<long long>(flights) * seats) {
+        cerr << "No more passengers than seats, please" << endl;
+        return 1;
+    }
+
+    SqlProfiler::instance().enable(1e9, "");  // Collects statements; nothing is slow enough to log
+    mt19937 random(1);
+    vector<string> flightNumbers, userIDs;
+    if (!prepareScratchDatabase(dbFile, 1, flights, seats, passengers, random, flightNumbers, userIDs)) return 1;
+
+    // Every batch command, so that every engine statement runs at least once
+    const string& f1 = flightNumbers[0];
+    const string& f2 = flightNumbers[min<size_t>(1, flightNumbers.size() - 1)];
+    const string& u1 = userIDs.empty() ? string("PC-none") : userIDs[0];
+    Flight first;
+    FlightCatalog::instance().find(f1, first);
+    string commands =
+        "add-flight PC1 \"Plan Check\" Alpha Beta 10\n"
+        "add-flight PC2 \"Plan Check\" Beta Gamma 10\n"
+        "modify-flight PC2 \"Plan Check\" Beta Gamma 12 12\n"
+        "book PCU1 \"Plan Check\" PC1 auto\n"
+        "book PCU1 \"Plan Check\" PC2 3\n"
+        "modify PCU1 \"Plan Checker\" PC2 4 PC2\n"
+        "modify PCU1 \"Plan Checker\" " + f1 + " " + to_string(seats) + " PC1\n"
+        "cancel PCU1 PC2\n"
+        "group PC1 PCG1 Ann PCG2 Bob\n"
+        "itinerary PCI1 Ivy PC1 PC2\n"
+        "seats " + f1 + "\n"
+        "routes Alpha Beta\n"
+        "routes \"" + first.startingPoint.substr(0, 1) + "*\"\n"
+        "connections Alpha Gamma\n"
+        "list-flights 5\n"
+        "list-flights 5 " + f2 + "\n"
+        "list-users 5\n"
+        "list-users 5 " + u1 + "\n"
+        "export flights csv /dev/null --from Alpha\n"
+        "export flights jsonl /dev/null\n"
+        "export users csv /dev/null --flight " + f1 + "\n"
+        "export users jsonl /dev/null\n"
+        "cancel " + u1 + "\n"
+        "delete-user PCI1\n"
+        "delete-flight PC2\n"
+        "stats\n";
+    string commandFile = dbFile + ".commands", flightFile = dbFile + ".flights.csv",
+           bookingFile = dbFile + ".bookings.csv", rejectFile = dbFile + ".rejects.csv";
+    ofstream(commandFile) << commands;
+    ofstream(flightFile) << "PC3,Plan Check,Gamma,Delta,5\nPC1,Duplicate,Alpha,Beta,5\n";
+    ofstream(bookingFile) << "PCB1,Importer,PC3,1\nPCB2,Importer,PC3,1\nPCB3,Importer,NOPE,1\n";
+
+    int failedCommands;
+    bool imported;
+    {
+        NullBuffer discard;
+        streambuf* out = cout.rdbuf(&discard);
+        streambuf* err = cerr.rdbuf(&discard);
+        failedCommands = runBatch(commandFile);
+        ImportStats stats;
+        imported = importFlights(flightFile, rejectFile, stats);
+        imported = importBookings(bookingFile, rejectFile, stats) && imported;
+        cout.rdbuf(out);
+        cerr.rdbuf(err);
+    }
+    for (const string& file : {commandFile, flightFile, bookingFile, rejectFile}) unlink(file.c_str());
+    // A failed step may have skipped statements, which would then pass unchecked
+    bool workloadOk = failedCommands == 0 && imported;
+    if (failedCommands != 0) cout << "FAIL  workload commands failed, so some statements didn't run\n";
+    if (!imported) cout << "FAIL  an importer failed, so some statements didn't run\n";
+
+    vector<StatementProfile> statements;
+    SqlProfiler::instance().snapshot(statements);
+    sort(statements.begin(), statements.end(), [](const StatementProfile& a, const StatementProfile& b) {
+        return a.sql < b.sql;
+    });
+
+    sqlite3* db = getConnection();
+    size_t scanning = 0, allowed = 0, unexplained = 0, skipped = 0;
+    for (const StatementProfile& statement : statements) {
+        sqlite3_stmt* explain = nullptr;
+        if (sqlite3_prepare_v2(db, ("EXPLAIN QUERY PLAN " + statement.example).c_str(), -1, &explain, nullptr) != SQLITE_OK) {
+            const char* reason = nullptr;
+            for (const auto& entry : PLAN_UNEXPLAINABLE) {
+                if (statement.sql.compare(0, strlen(entry.first), entry.first) == 0) reason = entry.second;
+            }
+            if (reason) skipped++;
+            else unexplained++;
+            if (verbose || !reason) {
+                cout << (reason ? "SKIP  " : "FAIL  ") << statement.sql << "\n";
+                cout << "        " << (reason ? reason : sqlite3_errmsg(db)) << "\n";
+            }
+            continue;
+        }
+        vector<string> plan;
+        set<string> subqueries;  // Scanning a bounded subquery's rows is not a table scan
+        bool scans = false;
+        while (sqlite3_step(explain) == SQLITE_ROW) {
+            string detail = reinterpret_cast<const char*>(sqlite3_column_text(explain, 3));
+            for (const char* kind : {"CO-ROUTINE ", "MATERIALIZE "}) {
+                if (detail.compare(0, strlen(kind), kind) == 0) subqueries.insert(detail.substr(strlen(kind)));
+            }
+            if (detail.compare(0, 5, "SCAN ") == 0 && detail != "SCAN CONSTANT ROW") {
+                string target = detail.substr(5, detail.find(' ', 5) - 5);
+                scans = scans || !subqueries.count(target);
+            }
+            plan.push_back(detail);
+        }
+        sqlite3_finalize(explain);
+
+        const char* reason = nullptr;
+        for (const auto& entry : PLAN_SCAN_ALLOWED) {
+            if (statement.sql == entry.first) reason = entry.second;
+        }
+        if (scans && !reason) scanning++;
+        if (scans && reason) allowed++;
+        if (verbose || (scans && !reason)) {
+            cout << (!scans ? "ok    " : reason ? "ALLOW " : "SCAN  ") << statement.sql << "\n";
+            for (const string& detail : plan) cout << "        " << detail << "\n";
+            if (scans && reason) cout << "        (" << reason << ")\n";
+        }
+    }
+    cout << statements.size() - skipped << " statements checked, " << allowed << " allowed to scan, "
+         << scanning << " scanning unexpectedly, " << unexplained << " that can't be explained ("
+         << skipped << " migration statements skipped)\n";
+    return scanning == 0 && unexplained == 0 && workloadOk ? 0 : 1;
 }
 
-// Display all users
-void displayUsers() {
-    cout << "\n--- User Information ---\n";
-    string sql = "SELECT * FROM Users ORDER BY userID;";
-    executeSQLWithCallback(sql, userCallback);
-}
\ No newline at end of file
+// Search flights by origin and destination
+void searchRoutesMenu() {
+    string from, to;
+    cout << "\nEnter Starting Point (end with * to match the beginning): ";
+    getline(cin, from);
+    cout << "Enter Destination (blank for any, end with * to match the beginning): ";
+    getline(cin, to);
+
+    vector<Flight> found;
+    if (!searchRoutes(from, to, found)) return;
+    if (found.empty()) {
+        cout << "No flights with available tickets on this route.\n";
+        return;
+    }
+
+    cout << "\n--- Matching Flights ---\n";
+    cout << left << setw(12) << "Flight" << setw(20) << "Airline" << setw(18) << "From"
+         << setw(18) << "To" << "Available\n";
+    for (const Flight& flight : found) {
+        cout << setw(12) << flight.flightNumber << setw(20) << flight.airlineName << setw(18)
+             << flight.startingPoint << setw(18) << flight.destination << flight.availableTickets << "\n";
+    }
+}
+
+// Find itineraries between two cities
+void findConnectionsMenu() {
+    string from, to;
+    cout << "\nEnter Starting Point: ";
+    getline(cin, from);
+    cout << "Enter Destination: ";
+    getline(cin, to);
+
+    vector<vector<Flight>> itineraries;
+    if (!FlightCatalog::instance().findConnections(from, to, CONNECTION_MAX_LEGS, CONNECTION_MAX_RESULTS,
+                                                   itineraries)) {
+        return;
+    }
+    if (itineraries.empty()) {
+        cout << "No connections with available tickets.\n";
+        return;
+    }
+
+    cout << "\n--- Connections ---\n";
+    for (size_t i = 0; i < itineraries.size(); i++) {
+        cout << i + 1 << ". ";
+        const vector<Flight>& legs = itineraries[i];
+        for (size_t leg = 0; leg < legs.size(); leg++) {
+            cout << (leg ? " -> " : "") << legs[leg].flightNumber << " " << legs[leg].startingPoint
+                 << "-" << legs[leg].destination;
+        }
+        cout << " (" << legs.size() << (legs.size() == 1 ? " leg)\n" : " legs)\n");
+    }
+}